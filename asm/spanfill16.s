@@ -0,0 +1,66 @@
+@--------------------------------------------------------------------------------
+@ spanfill16.s
+@--------------------------------------------------------------------------------
+@ Fills a span of 16-bit pixels (our mode 5 scanlines) with one colour.
+@ It replaces the memset16 call in m5_hline_nonorm (cf. source/render/rasteriser.h),
+@ which is the hottest loop of the rasteriser. Most spans are short (in the host build's
+@ scenes, the median span is 1 to 10 pixels long, and 58 to 99 % are shorter than 16),
+@ so the call overhead and generality of memset16 matter most: we handle short spans
+@ without saving any registers, and only write the body of longer spans with stmia
+@ bursts of 8 registers (16 pixels per store instruction).
+@
+@ void spanFill16(u16 *dst, u32 fill, uint count)
+@ r0: dst (halfword aligned) / r1: the colour in both halfwords (dup16) / r2: number of pixels (> 0; the
+@ rasterisers never pass empty spans, and we do not check for them here)
+@--------------------------------------------------------------------------------
+    .syntax unified
+    .section .iwram, "ax", %progbits
+    .align 2
+    .arm
+    .global spanFill16
+    .type spanFill16 STT_FUNC
+spanFill16:
+    @ Unaligned head pixel, so we can store words from now on
+    tst     r0, #2
+    strhne  r1, [r0], #2
+    subne   r2, r2, #1
+
+    @ Short spans (fewer than 16 pixels) don't pay for saving registers
+    cmp     r2, #16
+    blo     .Lwords
+
+    push    {r4-r8}
+    mov     r3, r1
+    mov     r4, r1
+    mov     r5, r1
+    mov     r6, r1
+    mov     r7, r1
+    mov     r8, r1
+    mov     r12, r1
+.Lburst:
+    @ 8 words (16 pixels) per iteration
+    stmia   r0!, {r1, r3-r8, r12}
+    sub     r2, r2, #16
+    cmp     r2, #16
+    bhs     .Lburst
+
+    @ At most one burst of 4 words (8 pixels) for the rest
+    cmp     r2, #8
+    stmiahs r0!, {r1, r3-r5}
+    subhs   r2, r2, #8
+    pop     {r4-r8}
+
+.Lwords:
+    @ The remaining pairs of pixels (at most 7 words)
+    subs    r2, r2, #2
+    blo     .Ltail
+.Lwordloop:
+    str     r1, [r0], #4
+    subs    r2, r2, #2
+    bhs     .Lwordloop
+
+.Ltail:
+    @ r2 is now 0xffffffff if there is one pixel left (and 0xfffffffe if not)
+    cmn     r2, #1
+    strheq  r1, [r0]
+    bx      lr
@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <tonc.h>
+
+#include "globals.h"
+#include "logutils.h"
+#include "math.h"
+#include "timer.h"
+#include "model.h"
+#include "scene.h"
+#include "render/draw.h"
+
+#include "scenes/cubespaceScene.h"
+#include "scenes/testbedScene.h"
+#include "scenes/moleculeScene.h"
+#include "scenes/subwayScene.h"
+#include "scenes/benchmarkScene.h"
+#include "scenes/twisterScene.h"
+#include "scenes/gbaScene.h"
+
+/*
+    Headless benchmark runner for the host build (cf. host/Makefile).
+    It runs each scene's update/draw for a fixed number of frames with a deterministic frame clock (REG_TM3D is stepped by a constant each frame),
+    prints the performance counters the engine registered (with wall-clock timings, cf. timer.c), and a hash over all frames the scene drew.
+    If the hash of a scene changes after touching the renderer, the image changed; the -o option dumps the last frame of each scene as a .ppm to look at.
+*/
+
+typedef struct HostScene {
+    const char *name;
+    void (*init)(void);
+    void (*start)(void);
+    void (*update)(void);
+    void (*draw)(void);
+} HostScene;
+
+// Keep this in sync with the scenes in source/scenes/config (scene.c itself is not used here, as the scenes would switch away from themselves).
+static const HostScene scenes[] = {
+    {"cubespaceScene", cubespaceSceneInit, cubespaceSceneStart, cubespaceSceneUpdate, cubespaceSceneDraw},
+    {"testbedScene", testbedSceneInit, testbedSceneStart, testbedSceneUpdate, testbedSceneDraw},
+    {"moleculeScene", moleculeSceneInit, moleculeSceneStart, moleculeSceneUpdate, moleculeSceneDraw},
+    {"subwayScene", subwaySceneInit, subwaySceneStart, subwaySceneUpdate, subwaySceneDraw},
+    {"benchmarkScene", benchmarkSceneInit, benchmarkSceneStart, benchmarkSceneUpdate, benchmarkSceneDraw},
+    {"twisterScene", twisterSceneInit, twisterSceneStart, twisterSceneUpdate, twisterSceneDraw},
+    {"gbaScene", gbaSceneInit, gbaSceneStart, gbaSceneUpdate, gbaSceneDraw},
+};
+#define HOST_SCENE_NUM ((int)(sizeof scenes / sizeof scenes[0]))
+
+static int perfUpdate, perfDraw;
+
+// The scenes switch to their successor when they're done; we want to keep benchmarking the current one, so we ignore that.
+void sceneSwitchTo(SceneID sceneID)
+{
+    (void)sceneID;
+}
+
+static u32 fnv1a(u32 hash, const void *data, size_t len)
+{
+    const u8 *bytes = data;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Hashes the visible part of the current write page (the 160x100 region in mode 5, the full 240x160 8bpp page in mode 4).
+static u32 hashFrame(u32 hash)
+{
+    if (g_mode == DCNT_MODE4) {
+        hash = fnv1a(hash, vid_page, M4_WIDTH * M4_HEIGHT);
+        return fnv1a(hash, pal_bg_mem, 256 * sizeof(COLOR));
+    }
+    for (int y = 0; y < M5_SCALED_H; ++y) {
+        hash = fnv1a(hash, vid_page + y * M5_WIDTH, M5_SCALED_W * sizeof(COLOR));
+    }
+    return hash;
+}
+
+static void dumpFrame(const char *dir, const char *name)
+{
+    char path[512];
+    snprintf(path, sizeof path, "%s/%s.ppm", dir, name);
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "hostbench: could not write '%s'\n", path);
+        return;
+    }
+    const bool m4 = g_mode == DCNT_MODE4;
+    const int w = m4 ? M4_WIDTH : M5_SCALED_W;
+    const int h = m4 ? M4_HEIGHT : M5_SCALED_H;
+    fprintf(f, "P6\n%d %d\n255\n", w, h);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            COLOR clr = m4 ? pal_bg_mem[((u8*)vid_page)[y * M4_WIDTH + x]] : vid_page[y * M5_WIDTH + x];
+            u8 rgb[3];
+            for (int c = 0; c < 3; ++c) {
+                int channel = (clr >> (5 * c)) & 31;
+                rgb[c] = (channel << 3) | (channel >> 2);
+            }
+            fwrite(rgb, 1, 3, f);
+        }
+    }
+    fclose(f);
+}
+
+static void runScene(const HostScene *scene, int numFrames, int frameTicks, const char *dumpDir)
+{
+    memset(hostVram, 0, sizeof hostVram);
+    performancePrintAll(); // Discard whatever has been gathered before (e.g. by the scene's init).
+    scene->start();
+
+    u32 hash = 2166136261u;
+    for (int frame = 0; frame < numFrames; ++frame) {
+        REG_TM3D += frameTicks;
+
+        performanceStart(perfUpdate);
+        scene->update();
+        performanceEnd(perfUpdate);
+
+        performanceStart(perfDraw);
+        scene->draw();
+        performanceEnd(perfDraw);
+
+        hash = hashFrame(hash);
+        if (dumpDir && frame == numFrames - 1) {
+            dumpFrame(dumpDir, scene->name);
+        }
+        vid_flip();
+
+        performanceGather();
+        timerTick(&g_timer);
+        ++g_frameCount;
+    }
+    printf("== %s: %d frames, mode %d, hash %08x\n", scene->name, numFrames, g_mode, (unsigned)hash);
+    performancePrintAll();
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-n frames] [-f fps] [-s scene] [-o dumpdir] [-r ot|sbuffer]\n", prog);
+    fprintf(stderr, "scenes:");
+    for (int i = 0; i < HOST_SCENE_NUM; ++i) {
+        fprintf(stderr, " %s", scenes[i].name);
+    }
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv)
+{
+    int numFrames = 240;
+    int fps = 30;
+    const char *sceneName = NULL;
+    const char *dumpDir = NULL;
+    const char *hsrName = "ot";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:f:s:o:r:h")) != -1) {
+        switch (opt) {
+            case 'n': numFrames = atoi(optarg); break;
+            case 'f': fps = atoi(optarg); break;
+            case 's': sceneName = optarg; break;
+            case 'o': dumpDir = optarg; break;
+            case 'r': hsrName = optarg; break;
+            default: usage(argv[0]); return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (numFrames <= 0 || fps <= 0 || (strcmp(hsrName, "ot") != 0 && strcmp(hsrName, "sbuffer") != 0)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // The same initialisation as in main.c, minus audio and interrupts.
+    hostShimInit();
+    sqran(2001);
+    globalsInit();
+    drawInit();
+    mathInit();
+    timerInit();
+    modelInit();
+    particlesInit();
+    for (int i = 0; i < HOST_SCENE_NUM; ++i) {
+        scenes[i].init();
+    }
+    drawSetHiddenSurfaceRemoval(strcmp(hsrName, "sbuffer") == 0 ? DRAW_HSR_SBUFFER : DRAW_HSR_ORDERING_TABLE); // After the scenes' init, in case they set it themselves.
+    perfUpdate = performanceDataRegister("hostbench: scene update");
+    perfDraw = performanceDataRegister("hostbench: scene draw");
+
+    const int frameTicks = (FIXED_12_SCALE + fps / 2) / fps; // REG_TM3D counts in 2^-12 seconds (cf. timerInit).
+    bool found = false;
+    for (int i = 0; i < HOST_SCENE_NUM; ++i) {
+        if (sceneName && strcmp(sceneName, scenes[i].name) != 0) {
+            continue;
+        }
+        found = true;
+        runScene(scenes + i, numFrames, frameTicks, dumpDir);
+    }
+    if (!found) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
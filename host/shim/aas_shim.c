@@ -0,0 +1,17 @@
+#include "AAS.h"
+
+/*
+    There's no audio on the host. We only need the handful of AAS functions and song symbols the scenes reference,
+    the actual sample data (data-audio/AAS_Data.s) is ARM assembly and not linked into the host build.
+*/
+
+const AAS_u8 AAS_DATA_MOD_aaa;
+const AAS_u8 AAS_DATA_MOD_BuxWV250;
+
+int AAS_MOD_Play(int song_num)
+{
+    (void)song_num;
+    return AAS_OK;
+}
+
+void AAS_MOD_Stop(void) {}
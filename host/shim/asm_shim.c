@@ -0,0 +1,13 @@
+#include "tonc.h"
+
+/*
+    C versions of our hand-written ARM assembly routines in asm/ (which the host can't assemble). 
+    They have to produce the same results; their speed on the host says nothing about the originals.
+*/
+
+void spanFill16(u16 *dst, u32 fill, uint count)
+{
+    while (count--) {
+        *dst++ = (u16)fill;
+    }
+}
@@ -0,0 +1,230 @@
+#ifndef HOST_TONC_SHIM_H
+#define HOST_TONC_SHIM_H
+
+/*
+    A tiny stand-in for the parts of libtonc we actually use, so the 3d pipeline (and the scenes) can be compiled for the host (cf. host/Makefile).
+    The definitions mirror libtonc's as closely as I could manage (fx2int truncates, lu_sin uses a 512-entry .12 table etc.),
+    but the "hardware" is just memory: vid_page points into a plain VRAM-sized buffer, the registers are globals, and everything
+    we can't (or don't want to) emulate, like text output and the BIOS waits, is a no-op.
+*/
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// --------------------------------------------------------------------
+// Types (tonc_types.h)
+// --------------------------------------------------------------------
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+typedef volatile u16 vu16;
+typedef volatile u32 vu32;
+typedef unsigned int uint;
+
+typedef s32 FIXED;
+typedef u16 COLOR;
+
+#define INLINE static inline
+#define ALIGN(n) __attribute__((aligned(n)))
+#define ALIGN4 __attribute__((aligned(4)))
+#define EWRAM_DATA
+#define IWRAM_DATA
+
+// --------------------------------------------------------------------
+// Math (tonc_math.h)
+// --------------------------------------------------------------------
+
+#define FIX_SHIFT 8
+#define FIX_SCALE (1 << FIX_SHIFT)
+#define FIX_MASK (FIX_SCALE - 1)
+#define FIX_SCALEF 256.0f
+
+#define ABS(x) ((x) >= 0 ? (x) : -(x))
+#define SGN(x) ((x) >= 0 ? 1 : -1)
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define CLAMP(x, min, max) ((x) >= (max) ? ((max) - 1) : (((x) < (min)) ? (min) : (x)))
+
+INLINE FIXED int2fx(int d) { return d << FIX_SHIFT; }
+INLINE FIXED float2fx(float f) { return (FIXED)(f * FIX_SCALEF); }
+INLINE int fx2int(FIXED fx) { return fx / FIX_SCALE; }
+INLINE float fx2float(FIXED fx) { return fx / FIX_SCALEF; }
+INLINE FIXED fxadd(FIXED fa, FIXED fb) { return fa + fb; }
+INLINE FIXED fxsub(FIXED fa, FIXED fb) { return fa - fb; }
+INLINE FIXED fxmul(FIXED fa, FIXED fb) { return (fa * fb) >> FIX_SHIFT; }
+INLINE FIXED fxdiv(FIXED fa, FIXED fb) { return ((fa) * FIX_SCALE) / (fb); }
+
+extern s16 sin_lut[514];
+INLINE s32 lu_sin(uint theta) { return sin_lut[(theta >> 7) & 0x1FF]; }
+INLINE s32 lu_cos(uint theta) { return sin_lut[((theta >> 7) + 128) & 0x1FF]; }
+
+void sqran(int seed);
+int qran(void);
+int qran_range(int min, int max);
+
+// --------------------------------------------------------------------
+// Memory and registers (tonc_memmap.h, tonc_memdef.h)
+// --------------------------------------------------------------------
+
+#define M3_WIDTH 240
+#define M3_HEIGHT 160
+#define M4_WIDTH 240
+#define M4_HEIGHT 160
+#define M5_WIDTH 160
+#define M5_HEIGHT 128
+#define SCREEN_WIDTH 240
+#define SCREEN_HEIGHT 160
+
+#define VRAM_PAGE_SIZE 0x0A000
+
+#define DCNT_MODE3 0x0003
+#define DCNT_MODE4 0x0004
+#define DCNT_MODE5 0x0005
+#define DCNT_PAGE 0x0010
+#define DCNT_BG2 0x0400
+
+#define TM_FREQ_1024 0x0003
+#define TM_CASCADE 0x0004
+#define TM_ENABLE 0x0080
+
+typedef struct BG_AFFINE {
+    s16 pa, pb, pc, pd;
+    s32 dx, dy;
+} ALIGN4 BG_AFFINE;
+
+typedef struct AFF_SRC_EX {
+    s32 tex_x, tex_y;
+    s16 scr_x, scr_y;
+    s16 sx, sy;
+    u16 alpha;
+} ALIGN4 AFF_SRC_EX;
+
+extern u16 hostVram[2 * VRAM_PAGE_SIZE / sizeof(u16)];
+extern COLOR hostPalBg[256];
+extern BG_AFFINE hostRegBgAffine[4];
+extern vu16 hostRegDispcnt, hostRegWaitcnt;
+extern vu16 hostRegTM2D, hostRegTM2CNT, hostRegTM3D, hostRegTM3CNT;
+
+#define vid_mem_front ((COLOR *)hostVram)
+#define vid_mem_back ((COLOR *)((u8 *)hostVram + VRAM_PAGE_SIZE))
+#define pal_bg_mem hostPalBg
+#define REG_BG_AFFINE hostRegBgAffine
+#define REG_DISPCNT hostRegDispcnt
+#define REG_WAITCNT hostRegWaitcnt
+#define REG_TM2D hostRegTM2D
+#define REG_TM2CNT hostRegTM2CNT
+#define REG_TM3D hostRegTM3D
+#define REG_TM3CNT hostRegTM3CNT
+
+void memset16(void *dst, u16 hw, uint hwcount);
+void memset32(void *dst, u32 wd, uint wcount);
+void memcpy16(void *dst, const void *src, uint hwcount);
+void memcpy32(void *dst, const void *src, uint wcount);
+
+INLINE u16 dup8(u8 x) { return x | (x << 8); }
+INLINE u32 dup16(u16 x) { return x | (x << 16); }
+INLINE u32 quad8(u8 x) { return x * 0x01010101; }
+
+// --------------------------------------------------------------------
+// BIOS (tonc_bios.h)
+// --------------------------------------------------------------------
+
+u32 Sqrt(u32 num);
+void Halt(void); // Nothing would ever wake us up on the host, so this ends the process with a failure (it's only called by panic).
+void VBlankIntrWait(void);
+void VBlankIntrDelay(uint count);
+
+// --------------------------------------------------------------------
+// Video (tonc_video.h)
+// --------------------------------------------------------------------
+
+#define CLR_BLACK 0x0000
+#define CLR_RED 0x001F
+#define CLR_LIME 0x03E0
+#define CLR_YELLOW 0x03FF
+#define CLR_BLUE 0x7C00
+#define CLR_MAG 0x7C1F
+#define CLR_CYAN 0x7FE0
+#define CLR_WHITE 0x7FFF
+#define CLR_MAROON 0x0010
+#define CLR_GREEN 0x0200
+#define CLR_NAVY 0x4000
+#define CLR_TEAL 0x4200
+#define CLR_PURPLE 0x4010
+#define CLR_OLIVE 0x0210
+#define CLR_ORANGE 0x021F
+#define CLR_FUCHSIA 0x7C1F
+#define CLR_GRAY 0x4210
+#define CLR_SILVER 0x6318
+
+extern COLOR *vid_page;
+
+INLINE COLOR RGB15(int red, int green, int blue) { return red | (green << 5) | (blue << 10); }
+INLINE COLOR RGB15_SAFE(int red, int green, int blue) { return (red & 31) | ((green & 31) << 5) | ((blue & 31) << 10); }
+
+COLOR *vid_flip(void);
+
+void bg_aff_identity(BG_AFFINE *bgaff);
+void bg_rotscale_ex(BG_AFFINE *bgaff, const AFF_SRC_EX *asx);
+
+void m3_fill(COLOR clr);
+void m3_puts(int x, int y, const char *str, COLOR clr);
+
+void m4_fill(u8 clrid);
+void m4_plot(int x, int y, u8 clrid);
+void m4_hline(int x1, int y, int x2, u8 clrid);
+void m4_line(int x1, int y1, int x2, int y2, u8 clrid);
+void m4_rect(int left, int top, int right, int bottom, u8 clrid);
+void m4_puts(int x, int y, const char *str, u8 clrid);
+
+void m5_fill(COLOR clr);
+void m5_plot(int x, int y, COLOR clr);
+void m5_hline(int x1, int y, int x2, COLOR clr);
+void m5_line(int x1, int y1, int x2, int y2, COLOR clr);
+void m5_rect(int left, int top, int right, int bottom, COLOR clr);
+void m5_puts(int x, int y, const char *str, COLOR clr);
+
+void txt_init_std(void);
+
+// --------------------------------------------------------------------
+// Input and interrupts (tonc_input.h, tonc_irq.h); there's no input on the host.
+// --------------------------------------------------------------------
+
+#define KEY_A 0x0001
+#define KEY_B 0x0002
+#define KEY_SELECT 0x0004
+#define KEY_START 0x0008
+#define KEY_RIGHT 0x0010
+#define KEY_LEFT 0x0020
+#define KEY_UP 0x0040
+#define KEY_DOWN 0x0080
+#define KEY_R 0x0100
+#define KEY_L 0x0200
+#define KEY_ANY 0x03FF
+
+INLINE void key_poll(void) {}
+INLINE u32 key_hit(u32 key) { (void)key; return 0; }
+INLINE u32 key_held(u32 key) { (void)key; return 0; }
+INLINE int key_tri_horz(void) { return 0; }
+INLINE int key_tri_vert(void) { return 0; }
+INLINE int key_tri_shoulder(void) { return 0; }
+INLINE int key_tri_fire(void) { return 0; }
+
+// --------------------------------------------------------------------
+// Host-only helpers (not part of libtonc).
+// --------------------------------------------------------------------
+
+size_t strlcpy(char *dst, const char *src, size_t size); // newlib has it, older glibc doesn't.
+
+void hostShimInit(void);
+u64 hostClockNs(void); // Monotonic wall-clock, used for the performance counters on the host (cf. timer.c).
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef HOST_TONC_MEMDEF_H
+#define HOST_TONC_MEMDEF_H
+
+// Everything lives in our tonc.h shim.
+#include "tonc.h"
+
+#endif
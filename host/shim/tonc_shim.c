@@ -0,0 +1,321 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "tonc.h"
+
+/*
+    Host implementations of the libtonc functions declared in our tonc.h shim.
+    The bitmap functions follow libtonc's bmp8/bmp16 routines (same normalisation, same exclusive right/bottom edges for rects etc.),
+    so the framebuffers we hash on the host are what the GBA would draw, give or take the text (m*_puts draws nothing here).
+*/
+
+u16 hostVram[2 * VRAM_PAGE_SIZE / sizeof(u16)];
+COLOR hostPalBg[256];
+BG_AFFINE hostRegBgAffine[4];
+vu16 hostRegDispcnt, hostRegWaitcnt;
+vu16 hostRegTM2D, hostRegTM2CNT, hostRegTM3D, hostRegTM3CNT;
+
+COLOR *vid_page = vid_mem_back;
+
+s16 sin_lut[514];
+
+static u32 qranSeed = 42;
+
+void hostShimInit(void)
+{
+    for (int i = 0; i < 514; ++i) { // The same .12 fixed point table libtonc ships, just computed instead of stored.
+        sin_lut[i] = (s16)lround(sin(i * 2.0 * M_PI / 512.0) * 4096.0);
+    }
+    memset(hostVram, 0, sizeof hostVram);
+    memset(hostPalBg, 0, sizeof hostPalBg);
+    vid_page = vid_mem_back;
+    hostRegDispcnt = 0;
+}
+
+u64 hostClockNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+
+void sqran(int seed)
+{
+    qranSeed = seed;
+}
+
+int qran(void)
+{
+    qranSeed = 1664525 * qranSeed + 1013904223;
+    return (qranSeed >> 16) & 0x7FFF;
+}
+
+int qran_range(int min, int max)
+{
+    return (qran() * (max - min) >> 15) + min;
+}
+
+void memset16(void *dst, u16 hw, uint hwcount)
+{
+    u16 *d = dst;
+    while (hwcount--) {
+        *d++ = hw;
+    }
+}
+
+void memset32(void *dst, u32 wd, uint wcount)
+{
+    u32 *d = dst;
+    while (wcount--) {
+        *d++ = wd;
+    }
+}
+
+void memcpy16(void *dst, const void *src, uint hwcount)
+{
+    memmove(dst, src, hwcount * 2);
+}
+
+void memcpy32(void *dst, const void *src, uint wcount)
+{
+    memmove(dst, src, wcount * 4);
+}
+
+u32 Sqrt(u32 num)
+{
+    u32 root = (u32)sqrt((double)num);
+    while ((u64)root * root > num) { // Make sure we floor like the BIOS does, whatever the double rounding did.
+        --root;
+    }
+    while ((u64)(root + 1) * (root + 1) <= num) {
+        ++root;
+    }
+    return root;
+}
+
+void Halt(void)
+{
+    fprintf(stderr, "Halt: nothing can wake us up on the host, exiting.\n");
+    exit(EXIT_FAILURE);
+}
+
+void VBlankIntrWait(void) {}
+
+void VBlankIntrDelay(uint count)
+{
+    (void)count;
+}
+
+COLOR *vid_flip(void)
+{
+    vid_page = (vid_page == vid_mem_front) ? vid_mem_back : vid_mem_front;
+    REG_DISPCNT ^= DCNT_PAGE;
+    return vid_page;
+}
+
+void bg_aff_identity(BG_AFFINE *bgaff)
+{
+    bgaff->pa = 0x0100; bgaff->pb = 0;
+    bgaff->pc = 0; bgaff->pd = 0x0100;
+    bgaff->dx = 0; bgaff->dy = 0;
+}
+
+void bg_rotscale_ex(BG_AFFINE *bgaff, const AFF_SRC_EX *asx)
+{
+    // We don't rotate on the host, and the display scaling doesn't affect the framebuffer, so only the scale is kept for reference.
+    bg_aff_identity(bgaff);
+    bgaff->pa = asx->sx;
+    bgaff->pd = asx->sy;
+    bgaff->dx = asx->tex_x - asx->scr_x * asx->sx;
+    bgaff->dy = asx->tex_y - asx->scr_y * asx->sy;
+}
+
+void txt_init_std(void) {}
+
+// --------------------------------------------------------------------
+// 16bpp bitmaps (modes 3 and 5)
+// --------------------------------------------------------------------
+
+static void bmp16Line(int x1, int y1, int x2, int y2, COLOR clr, u16 *base, int pitch)
+{
+    int dx, dy, xstep, ystep, dd;
+    u16 *dst = base + y1 * pitch + x1;
+
+    if (x1 > x2) {
+        xstep = -1; dx = x1 - x2;
+    } else {
+        xstep = +1; dx = x2 - x1;
+    }
+    if (y1 > y2) {
+        ystep = -pitch; dy = y1 - y2;
+    } else {
+        ystep = +pitch; dy = y2 - y1;
+    }
+
+    if (dy == 0) { // Horizontal
+        for (int i = 0; i <= dx; ++i) {
+            dst[i * xstep] = clr;
+        }
+    } else if (dx == 0) { // Vertical
+        for (int i = 0; i <= dy; ++i) {
+            dst[i * ystep] = clr;
+        }
+    } else if (dx >= dy) { // Diagonal, slope <= 1
+        dd = 2 * dy - dx;
+        for (int i = 0; i <= dx; ++i) {
+            *dst = clr;
+            if (dd >= 0) {
+                dd -= 2 * dx; dst += ystep;
+            }
+            dd += 2 * dy;
+            dst += xstep;
+        }
+    } else { // Diagonal, slope > 1
+        dd = 2 * dx - dy;
+        for (int i = 0; i <= dy; ++i) {
+            *dst = clr;
+            if (dd >= 0) {
+                dd -= 2 * dy; dst += xstep;
+            }
+            dd += 2 * dx;
+            dst += ystep;
+        }
+    }
+}
+
+static void bmp16Rect(int left, int top, int right, int bottom, COLOR clr, u16 *base, int pitch)
+{
+    if (left > right) {
+        int tmp = left; left = right; right = tmp;
+    }
+    if (top > bottom) {
+        int tmp = top; top = bottom; bottom = tmp;
+    }
+    for (int y = top; y < bottom; ++y) {
+        memset16(base + y * pitch + left, clr, right - left);
+    }
+}
+
+void m3_fill(COLOR clr)
+{
+    memset16(hostVram, clr, M3_WIDTH * M3_HEIGHT);
+}
+
+void m3_puts(int x, int y, const char *str, COLOR clr)
+{
+    (void)x; (void)y; (void)str; (void)clr;
+}
+
+void m5_fill(COLOR clr)
+{
+    memset16(vid_page, clr, M5_WIDTH * M5_HEIGHT);
+}
+
+void m5_plot(int x, int y, COLOR clr)
+{
+    vid_page[y * M5_WIDTH + x] = clr;
+}
+
+void m5_hline(int x1, int y, int x2, COLOR clr)
+{
+    if (x2 < x1) {
+        int tmp = x1; x1 = x2; x2 = tmp;
+    }
+    memset16(vid_page + y * M5_WIDTH + x1, clr, x2 - x1 + 1);
+}
+
+void m5_line(int x1, int y1, int x2, int y2, COLOR clr)
+{
+    bmp16Line(x1, y1, x2, y2, clr, vid_page, M5_WIDTH);
+}
+
+void m5_rect(int left, int top, int right, int bottom, COLOR clr)
+{
+    bmp16Rect(left, top, right, bottom, clr, vid_page, M5_WIDTH);
+}
+
+void m5_puts(int x, int y, const char *str, COLOR clr)
+{
+    (void)x; (void)y; (void)str; (void)clr;
+}
+
+// --------------------------------------------------------------------
+// 8bpp bitmaps (mode 4); we write bytes directly, the GBA's 16-bit VRAM bus is not emulated.
+// --------------------------------------------------------------------
+
+void m4_fill(u8 clrid)
+{
+    memset(vid_page, clrid, M4_WIDTH * M4_HEIGHT);
+}
+
+void m4_plot(int x, int y, u8 clrid)
+{
+    ((u8 *)vid_page)[y * M4_WIDTH + x] = clrid;
+}
+
+void m4_hline(int x1, int y, int x2, u8 clrid)
+{
+    if (x2 < x1) {
+        int tmp = x1; x1 = x2; x2 = tmp;
+    }
+    memset((u8 *)vid_page + y * M4_WIDTH + x1, clrid, x2 - x1 + 1);
+}
+
+void m4_line(int x1, int y1, int x2, int y2, u8 clrid)
+{
+    int dx = ABS(x2 - x1), dy = ABS(y2 - y1);
+    const int xstep = x1 > x2 ? -1 : 1, ystep = y1 > y2 ? -M4_WIDTH : M4_WIDTH;
+    u8 *dst = (u8 *)vid_page + y1 * M4_WIDTH + x1;
+    if (dx >= dy) { // Slope <= 1 (horizontal lines included)
+        int dd = 2 * dy - dx;
+        for (int i = 0; i <= dx; ++i) {
+            *dst = clrid;
+            if (dd >= 0) {
+                dd -= 2 * dx; dst += ystep;
+            }
+            dd += 2 * dy;
+            dst += xstep;
+        }
+    } else { // Slope > 1 (vertical lines included)
+        int dd = 2 * dx - dy;
+        for (int i = 0; i <= dy; ++i) {
+            *dst = clrid;
+            if (dd >= 0) {
+                dd -= 2 * dy; dst += xstep;
+            }
+            dd += 2 * dx;
+            dst += ystep;
+        }
+    }
+}
+
+void m4_rect(int left, int top, int right, int bottom, u8 clrid)
+{
+    if (left > right) {
+        int tmp = left; left = right; right = tmp;
+    }
+    if (top > bottom) {
+        int tmp = top; top = bottom; bottom = tmp;
+    }
+    for (int y = top; y < bottom; ++y) {
+        memset((u8 *)vid_page + y * M4_WIDTH + left, clrid, right - left);
+    }
+}
+
+void m4_puts(int x, int y, const char *str, u8 clrid)
+{
+    (void)x; (void)y; (void)str; (void)clrid;
+}
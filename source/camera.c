@@ -40,6 +40,7 @@ Camera cameraNew(Vec3 pos, FIXED fov, FIXED near, FIXED far, int mode)
     new.fov = fov;
     new.near = near;
     new.far = far;
+    new.mode = mode;
     matrix4x4setIdentity(new.cam2world);
     matrix4x4setIdentity(new.world2cam);
     // Read/write: 
@@ -48,6 +49,7 @@ Camera cameraNew(Vec3 pos, FIXED fov, FIXED near, FIXED far, int mode)
     new.pitch = int2fx12(0);
     new.roll = int2fx12(0);
     new.lookAt = (Vec3){.x=0, .y=0, .z=0};
+    new.world2camBaked = false;
     cameraComputePerspectiveMatrix(&new);
     return new;
 }
@@ -67,6 +69,10 @@ static void cameraComputeRotMatrix(Camera *cam, FIXED result[16])
 
 void cameraComputeWorldToCamSpace(Camera *cam) 
 {
+    if (cam->world2camBaked) { // (cf. cameraPathApply)
+        cam->world2camBaked = false;
+        return;
+    }
     matrix4x4setIdentity(cam->world2cam);
     // Compute new basis of the matrix from our lookAt point:
     Vec3 forward = vecUnit(vecSub(cam->pos, cam->lookAt));
@@ -141,4 +147,66 @@ void cameraComputePerspectiveMatrix(Camera *cam)
 
     cam->viewportTransFacY = viewport2image[5];
     cam->viewportTransAddY = viewport2image[7];
-}
\ No newline at end of file
+
+    // The side planes of the frustum have the normals (±perspFacX, 0, 1) and (0, ±perspFacY, 1) in camera space (cf. the frustum checks in drawPoints).
+    cam->frustumSideNormLenX = float2fx(sqrt(fx2float(cam->perspFacX) * fx2float(cam->perspFacX) + 1.));
+    cam->frustumSideNormLenY = float2fx(sqrt(fx2float(cam->perspFacY) * fx2float(cam->perspFacY) + 1.));
+}
+
+
+// One coordinate of the uniform Catmull-Rom spline through p0 to p3 (from p1 at t = 0 to p2 at t = 1), with Horner's method and 64-bit intermediates (the coefficients can get large). 
+static FIXED catmullRom(s64 p0, s64 p1, s64 p2, s64 p3, FIXED_12 t) 
+{
+    const s64 a = -p0 + 3 * p1 - 3 * p2 + p3;
+    const s64 b = 2 * p0 - 5 * p1 + 4 * p2 - p3;
+    const s64 c = -p0 + p2;
+    const s64 d = 2 * p1;
+    return (FIXED)(((((((a * t) >> 12) + b) * t >> 12) + c) * t >> 12) + d) >> 1;
+}
+
+void cameraPathSample(const CameraPath *path, FIXED_12 time, Vec3 *pos, Vec3 *lookAt) 
+{
+    assertion(path->numKeys >= 2, "camera.c: cameraPathSample: numKeys >= 2");
+    const CameraKey *keys = path->keys;
+    const int last = path->numKeys - 1;
+    time = MAX(keys[0].time, MIN(time, keys[last].time));
+    int i = 0; // We're between keys[i] and keys[i + 1]. 
+    while (i < last - 1 && time >= keys[i + 1].time) {
+        ++i;
+    }
+    const FIXED_12 t = fx12div(time - keys[i].time, keys[i + 1].time - keys[i].time);
+    const CameraKey *k0 = keys + MAX(i - 1, 0), *k1 = keys + i, *k2 = keys + i + 1, *k3 = keys + MIN(i + 2, last); // (The first and last key are repeated at the ends.)
+    pos->x = catmullRom(k0->pos.x, k1->pos.x, k2->pos.x, k3->pos.x, t);
+    pos->y = catmullRom(k0->pos.y, k1->pos.y, k2->pos.y, k3->pos.y, t);
+    pos->z = catmullRom(k0->pos.z, k1->pos.z, k2->pos.z, k3->pos.z, t);
+    lookAt->x = catmullRom(k0->lookAt.x, k1->lookAt.x, k2->lookAt.x, k3->lookAt.x, t);
+    lookAt->y = catmullRom(k0->lookAt.y, k1->lookAt.y, k2->lookAt.y, k3->lookAt.y, t);
+    lookAt->z = catmullRom(k0->lookAt.z, k1->lookAt.z, k2->lookAt.z, k3->lookAt.z, t);
+}
+
+/* 
+    With a baked path, world2cam is interpolated linearly between the two closest samples (which isn't quite a rotation anymore, but close enough at 30 samples per second), 
+    and cameraComputeWorldToCamSpace (three square roots and three 4x4 matrix products) is skipped for the next frame. 
+*/
+void cameraPathApply(Camera *cam, const CameraPath *path, FIXED_12 time) 
+{
+    cameraPathSample(path, time, &cam->pos, &cam->lookAt); // (The position is needed for culling and lighting anyway.)
+    if (!path->bakedWorld2cam) {
+        return;
+    }
+    assertion(!cam->yaw && !cam->pitch && !cam->roll, "camera.c: cameraPathApply: Baked paths don't support yaw, pitch and roll.");
+    const s32 sample = MAX(time - path->keys[0].time, 0) * path->bakeRate; // (.12 fixed point)
+    int idx = sample >> 12;
+    FIXED_12 frac = sample & (FIXED_12_SCALE - 1);
+    if (idx >= path->numBaked - 1) {
+        idx = path->numBaked - 2;
+        frac = FIXED_12_SCALE;
+    }
+    const FIXED *a = path->bakedWorld2cam[idx], *b = path->bakedWorld2cam[idx + 1];
+    for (int i = 0; i < 12; ++i) {
+        cam->world2cam[i] = a[i] + (((b[i] - a[i]) * frac) >> 12);
+    }
+    cam->world2cam[12] = cam->world2cam[13] = cam->world2cam[14] = 0;
+    cam->world2cam[15] = int2fx(1);
+    cam->world2camBaked = true;
+}
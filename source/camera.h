@@ -11,6 +11,7 @@ typedef struct Camera {
     FIXED perspMat[16];
     FIXED viewport2imageMat[16];
     FIXED perspFacX, perspFacY, viewportTransFacX, viewportTransFacY, viewportTransAddX, viewportTransAddY;
+    FIXED frustumSideNormLenX, frustumSideNormLenY; // Lengths of the (unnormalised) normals of the left/right and top/bottom frustum planes, used for culling bounding spheres (cf. draw.c).
     FIXED cam2world[16]; 
     FIXED world2cam[16];
     Vec3 pos;
@@ -21,10 +22,36 @@ typedef struct Camera {
     FIXED viewportWidth, viewportHeight;
     FIXED aspect;
     FIXED fov, near, far;
+    int mode; // The video mode the camera renders for (DCNT_MODE5 or DCNT_MODE4, cf. drawModelInstancePools).
+    bool world2camBaked; // Set by cameraPathApply if it took world2cam from a baked table; the next cameraComputeWorldToCamSpace keeps it then.
 } ALIGN4 Camera;
 
+/* 
+    A camera path: a Catmull-Rom spline through the keys (for the position and the lookAt point alike), which is traversed in the time between the first and the last key. 
+    Paths are generated from assets/campaths by tools/campath2c.py, which can also bake the world2cam matrices along the path into ROM at a fixed rate, 
+    so following it only costs a table lookup and a linear interpolation per frame instead of cameraComputeWorldToCamSpace (cf. cameraPathApply). 
+    cf. https://en.wikipedia.org/wiki/Centripetal_Catmull%E2%80%93Rom_spline (last retrieved 2021-08-25) (we use the uniform variant, though)
+*/
+typedef struct CameraKey {
+    FIXED_12 time; // In seconds since the start of the path (increasing).
+    Vec3 pos, lookAt;
+} CameraKey;
+
+typedef struct CameraPath {
+    const CameraKey *keys;
+    int numKeys;
+    // The upper three rows of world2cam (the last one is always (0, 0, 0, 1)), bakeRate times per second from the time of the first key on, or NULL.
+    const FIXED (*bakedWorld2cam)[12]; 
+    int numBaked, bakeRate;
+} CameraPath;
+
 Camera cameraNew(Vec3 pos, FIXED fov, FIXED near, FIXED far, int mode);
 IWRAM_CODE_ARM void cameraComputePerspectiveMatrix(Camera *cam);
 IWRAM_CODE_ARM void cameraComputeWorldToCamSpace(Camera *cam);
 
+// The position and lookAt point on the path at the given time (clamped to the time of the first and the last key). 
+void cameraPathSample(const CameraPath *path, FIXED_12 time, Vec3 *pos, Vec3 *lookAt);
+// Moves the camera to the position on the path at the given time (cf. CameraPath); baked paths don't support yaw, pitch and roll.
+void cameraPathApply(Camera *cam, const CameraPath *path, FIXED_12 time);
+
 #endif
\ No newline at end of file
@@ -1,7 +1,11 @@
 #ifndef COMMONDEFS_H
 #define COMMONDEFS_H
 
+#ifdef HOST_BUILD // The host build (cf. host/Makefile) has neither IWRAM nor ARM/Thumb code.
+#define IWRAM_CODE_ARM
+#else
 #define IWRAM_CODE_ARM  __attribute__((target("arm"), section(".iwram")))
+#endif
 
 #define M5_SCALED_W 160
 #define M5_SCALED_H 100
@@ -1,6 +1,8 @@
 #include "globals.h"
+#include "commondefs.h"
 
 int g_mode = DCNT_MODE5;
+int g_rasterWidth = M5_SCALED_W, g_rasterHeight = M5_SCALED_H;
 
 Timer g_timer;
 int g_frameCount;
@@ -7,6 +7,7 @@
 // #define DEBUG_PRINT
 
 extern int g_mode;
+extern int g_rasterWidth, g_rasterHeight; // The size of the frame the 3d renderer draws into (set by drawModelInstancePools according to the camera's mode). 
 extern Timer g_timer;
 extern int g_frameCount;
 
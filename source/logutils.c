@@ -30,15 +30,18 @@
 
 //! Outputs \a fmt formatted with varargs to mGBA's logger with \a level priority
 void mgba_printf(const char* fmt, ...) {
-	REG_LOG_ENABLE = 0xC0DE;
-	REG_LOG_LEVEL = LOG_INFO;
-
 	va_list args;
 	va_start(args, fmt);
+#ifdef HOST_BUILD // No mGBA on the host (cf. host/Makefile), we just log to stdout.
+	vprintf(fmt, args);
+	putchar('\n');
+#else
+	REG_LOG_ENABLE = 0xC0DE;
+	REG_LOG_LEVEL = LOG_INFO;
 
 	char* const log = (char*) 0x4FFF600;
 	vsnprintf(log, 0x100, fmt, args);
-
+#endif
 	va_end(args);
 }
 
@@ -7,6 +7,7 @@
 #include "timer.h"
 #include "scene.h"
 #include "model.h"
+#include "particles.h"
 #include "render/draw.h"
 
 #include "../data-audio/AAS_Data.h"
@@ -32,6 +33,7 @@ int main(void)
     mathInit();
     timerInit();
     modelInit();
+    particlesInit();
     scenesInit();
     logutilsInit(6);
 
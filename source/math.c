@@ -6,7 +6,6 @@
 #include "logutils.h"
 #include "timer.h"
 
-// #define MATH_FAST_DIVISION (TODO: We don't use a LUT for divisions for now (which is not ideal); I ran into issues since the range of divisors was quite limited with the LUT, so I'll figure it out later)
 
 /*
     NOTE: The matrices and vectors are assumed to be in "column major order" conceptually throughout our whole codebase. 
@@ -16,9 +15,42 @@
 
 static int perfID;
 
+/* 
+    The reciprocal LUTs (cf. math.h). The fixed point reciprocals are stored as 16-bit mantissas for each octave (reciprocalLut), which keeps the table small and makes it cheap to read from EWRAM (16-bit bus). 
+    We can't count leading zeros on the ARM7, so reciprocalOctaveLut gives us the octave for the integer part of the denominator. 
+    The integer reciprocals are 32 bits wide (two accesses on EWRAM's 16-bit bus, both with wait states), but only 1 KB, so they go into IWRAM. 
+*/
+EWRAM_DATA u16 reciprocalLut[RECIPROCAL_OCTAVES << RECIPROCAL_OCTAVE_BITS];
+IWRAM_DATA u8 reciprocalOctaveLut[RECIPROCAL_MAX >> FIX_SHIFT];
+IWRAM_DATA u32 reciprocalIntLut[RECIPROCAL_INT_LUT_SIZE];
+
+static void reciprocalLutsInit(void) 
+{
+    reciprocalOctaveLut[0] = 0; // Not in the range of the LUT anyway.
+    for (int i = 1; i < (RECIPROCAL_MAX >> FIX_SHIFT); ++i) {
+        int octave = 0;
+        while ((2 << octave) <= i) {
+            ++octave;
+        }
+        reciprocalOctaveLut[i] = octave;
+    }
+    for (int octave = 0; octave < RECIPROCAL_OCTAVES; ++octave) {
+        for (int bucket = 0; bucket < (1 << RECIPROCAL_OCTAVE_BITS); ++bucket) {
+            // We take the reciprocal of the center of each bucket (in .1 fixed point, so we can represent it), which halves the error; the result is in [2^15, 2^16). 
+            const u64 bucketCenter = ((2ull << RECIPROCAL_OCTAVE_BITS) + 2 * bucket + 1) << octave; 
+            reciprocalLut[(octave << RECIPROCAL_OCTAVE_BITS) + bucket] = ((1ull << (octave + 16 + RECIPROCAL_OCTAVE_BITS + 1)) + bucketCenter / 2) / bucketCenter;
+        }
+    }
+    reciprocalIntLut[0] = reciprocalIntLut[1] = 0; // Not in the range of the LUT (1 / 1 doesn't fit into 32 bits).
+    for (int i = 2; i < RECIPROCAL_INT_LUT_SIZE; ++i) {
+        reciprocalIntLut[i] = ((1ull << 32) + i - 1) / i; // Rounded up, so the quotients are exact (cf. idivFast).
+    }
+}
+
 void mathInit(void) 
 {
     perfID = performanceDataRegister("math: func");
+    reciprocalLutsInit();
 }
 
 
@@ -86,6 +118,16 @@ Vec3 vecTransformedRot(FIXED rotmat[16], const Vec3 *v)
     return rotated;
 }
 
+// The inverse of a rotation matrix is its transpose, so we just multiply with the columns instead of the rows. 
+Vec3 vecTransformedRotInverse(const FIXED rotmat[16], const Vec3 *v) 
+{
+    Vec3 rotated;
+    rotated.x = fxmul(v->x, rotmat[0]) + fxmul(v->y, rotmat[4]) + fxmul(v->z, rotmat[8]);
+    rotated.y = fxmul(v->x, rotmat[1]) + fxmul(v->y, rotmat[5]) + fxmul(v->z, rotmat[9]);
+    rotated.z = fxmul(v->x, rotmat[2]) + fxmul(v->y, rotmat[6]) + fxmul(v->z, rotmat[10]);
+    return rotated;
+}
+
 Vec3 vecScaled(Vec3 vec, FIXED factor) 
 {
     vec.x = fxmul(vec.x, factor);
@@ -253,21 +295,42 @@ void matrix4x4createRotZ(FIXED matrix[16], ANGLE_FIXED_12 angle)
 void matrix4x4createYawPitchRoll(FIXED matrix[16], ANGLE_FIXED_12 yaw, ANGLE_FIXED_12 pitch, ANGLE_FIXED_12 roll) 
 {
     matrix4x4setIdentity(matrix);
+    FIXED sinYaw, cosYaw, sinPitch, cosPitch, sinRoll, cosRoll; // (One table lookup per angle instead of a dozen calls of sinFx and cosFx.)
+    sinCosFx(yaw, &sinYaw, &cosYaw);
+    sinCosFx(pitch, &sinPitch, &cosPitch);
+    sinCosFx(roll, &sinRoll, &cosRoll);
     // M = rotYaw * rotPitch * rotRoll (to think of the rotations in local space, read from left to right (we use coloum major vectors/matrices))
-    matrix[0] = fxmul(cosFx(roll), cosFx(yaw)) + fxmul(fxmul(sinFx(roll), sinFx(yaw)), sinFx(pitch));
-    matrix[1] = -fxmul(sinFx(roll), cosFx(yaw)) + fxmul(fxmul(cosFx(roll), sinFx(yaw)), sinFx(pitch));
-    matrix[2] = fxmul(sinFx(yaw), cosFx(pitch));
+    matrix[0] = fxmul(cosRoll, cosYaw) + fxmul(fxmul(sinRoll, sinYaw), sinPitch);
+    matrix[1] = -fxmul(sinRoll, cosYaw) + fxmul(fxmul(cosRoll, sinYaw), sinPitch);
+    matrix[2] = fxmul(sinYaw, cosPitch);
     // matrix[3] = 0;
-    matrix[4] = fxmul(sinFx(roll), cosFx(pitch));
-    matrix[5] = fxmul(cosFx(roll), cosFx(pitch));
-    matrix[6] = -sinFx(pitch);
+    matrix[4] = fxmul(sinRoll, cosPitch);
+    matrix[5] = fxmul(cosRoll, cosPitch);
+    matrix[6] = -sinPitch;
     // matrix[7] = 0;
-    matrix[8] = fxmul(-cosFx(roll), sinFx(yaw)) + fxmul(fxmul(sinFx(roll), cosFx(yaw)), sinFx(pitch));
-    matrix[9] = fxmul(sinFx(roll), sinFx(yaw)) + fxmul(fxmul(cosFx(roll), cosFx(yaw)), sinFx(pitch));
-    matrix[10] = fxmul(cosFx(pitch), cosFx(yaw));
+    matrix[8] = fxmul(-cosRoll, sinYaw) + fxmul(fxmul(sinRoll, cosYaw), sinPitch);
+    matrix[9] = fxmul(sinRoll, sinYaw) + fxmul(fxmul(cosRoll, cosYaw), sinPitch);
+    matrix[10] = fxmul(cosPitch, cosYaw);
 }
 
 
+/* 
+    Concatenates scale, rotation (rotmat), translation (pos), and the world to camera space transform (an affine one) into a single 3x4 matrix (cf. math.h):
+    result = world2cam * translation(pos) * rotmat * scale(scale)
+    We keep the .16 fixed point products of the .8 fixed point entries, so we don't lose precision compared to transforming in several steps. 
+*/
+void matrix3x4createModelToCam(s32 result[12], const FIXED world2cam[16], const FIXED rotmat[16], Vec3 scale, Vec3 pos) 
+{
+    const FIXED s[3] = {scale.x, scale.y, scale.z};
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 3; ++col) {
+            const s32 rot = world2cam[row * 4] * rotmat[col] + world2cam[row * 4 + 1] * rotmat[4 + col] + world2cam[row * 4 + 2] * rotmat[8 + col]; // .16
+            result[row * 4 + col] = (s32)(((s64)rot * s[col]) >> FIX_SHIFT);
+        }
+        result[row * 4 + 3] = (s32)((((s64)world2cam[row * 4] * pos.x) + ((s64)world2cam[row * 4 + 1] * pos.y) + ((s64)world2cam[row * 4 + 2] * pos.z)) >> FIX_SHIFT) + world2cam[row * 4 + 3];
+    }
+}
+
 void matrix4x4Mul(FIXED a[16], const FIXED b[16]) 
 {
     FIXED result[16];
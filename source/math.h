@@ -18,6 +18,29 @@ typedef struct Vec3 {
 typedef s32 FIXED_12;
 typedef FIXED_12 ANGLE_FIXED_12;
 
+/* 
+    With MATH_FAST_DIVISION, fxDivFast/fxReciprocalFast (perspective divides) and idivFast (edge slopes in the rasteriser) use the reciprocal LUTs 
+    set up in mathInit instead of actual divisions for the ranges the LUTs cover, and fall back to regular divisions otherwise. 
+    (Comment it out to compare.)
+*/
+#define MATH_FAST_DIVISION
+
+/*
+    The fixed point reciprocal LUT covers denominators from RECIPROCAL_MIN (inclusive) to RECIPROCAL_MAX (exclusive), i.e. all depths between a near plane at 1 and a far plane at 256 (and then some). 
+    Each power-of-two range ("octave") of denominators is split into 2^RECIPROCAL_OCTAVE_BITS buckets, which bounds the relative error to 2^-(RECIPROCAL_OCTAVE_BITS + 1) (about 0.2 %, less than a fifth of a pixel at the border of the screen).
+*/
+#define RECIPROCAL_MIN (1 << FIX_SHIFT)
+#define RECIPROCAL_MAX (512 << FIX_SHIFT)
+#define RECIPROCAL_OCTAVES 9
+#define RECIPROCAL_OCTAVE_BITS 8
+#define RECIPROCAL_FRACT_SHIFT 24 // The reciprocals returned by fxReciprocalFast are in .24 fixed point.
+// The integer reciprocal LUT covers denominators from 2 to RECIPROCAL_INT_LUT_SIZE - 1 (the height of triangle sections in pixels).
+#define RECIPROCAL_INT_LUT_SIZE 256
+
+extern u16 reciprocalLut[RECIPROCAL_OCTAVES << RECIPROCAL_OCTAVE_BITS];
+extern u8 reciprocalOctaveLut[RECIPROCAL_MAX >> FIX_SHIFT];
+extern u32 reciprocalIntLut[RECIPROCAL_INT_LUT_SIZE];
+
 
 IWRAM_CODE_ARM Vec3 vecScaled(Vec3 vec, FIXED factor);
 IWRAM_CODE_ARM void vecScale(Vec3 *vec, FIXED factor);
@@ -33,6 +56,15 @@ IWRAM_CODE_ARM Vec3 vecTransformed(const FIXED matrix[16], Vec3 vec);
 IWRAM_CODE_ARM void vecTransform(const FIXED matrix[16], Vec3 *vec);
 IWRAM_CODE_ARM void vecTranformAffine(const FIXED matrix[16], Vec3 *vec);
 IWRAM_CODE_ARM Vec3 vecTransformedRot(FIXED rotmat[16], const Vec3 *v);
+IWRAM_CODE_ARM Vec3 vecTransformedRotInverse(const FIXED rotmat[16], const Vec3 *v);
+
+/* 
+    Affine 3x4 matrices (the upper three rows of a 4x4 matrix, as the last one is (0, 0, 0, 1) anyway), e.g. to transform vertices from model to camera space in one go. 
+    The entries of the left 3x3 part (rotation and scale) are in .16 fixed point (the product of two .8 fixed point rotation matrices fits into that exactly), 
+    the translation (index 3, 7, 11) is in .8 fixed point like everything else. 
+*/
+#define MATRIX3X4_FRACT_SHIFT 16
+IWRAM_CODE_ARM void matrix3x4createModelToCam(s32 result[12], const FIXED world2cam[16], const FIXED rotmat[16], Vec3 scale, Vec3 pos);
 
 IWRAM_CODE_ARM void matrix4x4setIdentity(FIXED matrix[16]);
 IWRAM_CODE_ARM void matrix4x4SetTranslation(FIXED matrix[16], Vec3 translation);
@@ -94,15 +126,71 @@ INLINE FIXED sinFx(FIXED_12 alpha) {
     return alpha < 0 ? -fx12Tofx(lu_sin(ABS(alpha) & 0xffff) ) : fx12Tofx(lu_sin(alpha & 0xffff));
 }
 
+// sinFx and cosFx at once (with the same results), the index into the table is only computed once. 
+INLINE void sinCosFx(ANGLE_FIXED_12 alpha, FIXED *sin, FIXED *cos) {
+    const uint idx = (ABS(alpha) & 0xffff) >> 7;
+    const FIXED s = fx12Tofx(sin_lut[idx & 0x1ff]);
+    *sin = alpha < 0 ? -s : s;
+    *cos = fx12Tofx(sin_lut[(idx + 128) & 0x1ff]);
+}
+
 
-// INLINE FIXED fxDivFast(FIXED num, FIXED denom) { // IMPORTANT: has limited range, up to RECIPROCAL_MAX_RANGE; should only be used for perspective divide
-//     panic("fxdivfast is deprecated");
-//     assertion(denom != 0, "lutfxDiv: denom != 0");
-//     assertion(fx2int(denom) < RECIPROCAL_MAX_INT, "fxDivFast: lut out of range");
-//     FIXED invDenom = reciprocalLUT[(ABS(denom) - 1) & (RECIPROCAL_LUT_SIZE - 1)]; // abs instead of uint
-//     FIXED u_result = (num * invDenom) >> (RECIPROCAL_FRACT_SHIFT) >> (RECIPROCAL_FRACT_SHIFT - FIX_SHIFT);
-//     return denom < 0 ? -u_result: u_result; // don't assume denom is positive
-// }
+/* 
+    Returns 1 / denom in .24 fixed point (use it with fxMulReciprocal), so we only need one lookup if we divide several values by the same denominator (e.g. x and y by z). 
+    Denominators outside of [RECIPROCAL_MIN, RECIPROCAL_MAX) fall back to a (slow, 64-bit) division.
+*/
+INLINE s32 fxReciprocalFast(FIXED denom) 
+{
+    #ifdef MATH_FAST_DIVISION
+    if (denom >= RECIPROCAL_MIN && denom < RECIPROCAL_MAX) {
+        // denom is in [2^(octave + FIX_SHIFT), 2^(octave + FIX_SHIFT + 1)); the RECIPROCAL_OCTAVE_BITS bits below its leading one select the bucket.
+        const int octave = reciprocalOctaveLut[denom >> FIX_SHIFT];
+        const int bucket = (denom >> (octave + FIX_SHIFT - RECIPROCAL_OCTAVE_BITS)) & ((1 << RECIPROCAL_OCTAVE_BITS) - 1);
+        return reciprocalLut[(octave << RECIPROCAL_OCTAVE_BITS) + bucket] << (RECIPROCAL_FRACT_SHIFT - 16 - octave);
+    }
+    #endif
+    return (s32)((1ll << (RECIPROCAL_FRACT_SHIFT + FIX_SHIFT)) / denom);
+}
+
+INLINE FIXED fxMulReciprocal(FIXED num, s32 reciprocal) 
+{
+    return (FIXED)(((s64)num * reciprocal) >> RECIPROCAL_FRACT_SHIFT);
+}
+
+// Like fxdiv, but uses the reciprocal LUT if the denominator is in its range (cf. fxReciprocalFast). 
+INLINE FIXED fxDivFast(FIXED num, FIXED denom) 
+{
+    #ifdef MATH_FAST_DIVISION
+    if (denom >= RECIPROCAL_MIN && denom < RECIPROCAL_MAX) {
+        return fxMulReciprocal(num, fxReciprocalFast(denom));
+    }
+    #endif
+    return fxdiv(num, denom);
+}
+
+/* 
+    Integer division (truncating towards zero like '/') for small positive denominators, e.g. the height of a triangle section when we calculate the edge slopes. 
+    Exact for all numerators we use (up to 2^25 in magnitude) as long as denom < 128, and off by at most one unit in the last place for denominators up to RECIPROCAL_INT_LUT_SIZE.
+*/
+INLINE int idivFast(int num, int denom) 
+{
+    #ifdef MATH_FAST_DIVISION
+    if (denom > 1 && denom < RECIPROCAL_INT_LUT_SIZE) {
+        const int absQuotient = (int)(((u64)ABS(num) * reciprocalIntLut[denom]) >> 32);
+        return num < 0 ? -absQuotient : absQuotient;
+    }
+    #endif
+    return num / denom;
+}
+
+// Transforms the point (x, y, z) with an affine 3x4 matrix (cf. matrix3x4createModelToCam); 9 multiplications (ARM's smull/smlal) instead of the 16 of vecTransform.
+// (It takes the coordinates instead of a Vec3, as our model vertices are packed into 16 bits, cf. ModelVert in model.h.)
+INLINE void vecTransform3x4(const s32 m[12], FIXED x, FIXED y, FIXED z, Vec3 *out) 
+{
+    out->x = (FIXED)((((s64)m[0] * x) + ((s64)m[1] * y) + ((s64)m[2] * z)) >> MATRIX3X4_FRACT_SHIFT) + m[3];
+    out->y = (FIXED)((((s64)m[4] * x) + ((s64)m[5] * y) + ((s64)m[6] * z)) >> MATRIX3X4_FRACT_SHIFT) + m[7];
+    out->z = (FIXED)((((s64)m[8] * x) + ((s64)m[9] * y) + ((s64)m[10] * z)) >> MATRIX3X4_FRACT_SHIFT) + m[11];
+}
 
 INLINE FIXED_12 freq(FIXED_12 hz) {
     return fx12mul(hz, TAU);
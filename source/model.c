@@ -10,8 +10,9 @@
 #include "render/draw.h"
 #include "globals.h"
 
-static Vec3 cubeModelVerts[8];
+static ModelVert cubeModelVerts[8];
 static Face cubeModelFaces[12];
+static Vec3 cubeModelNormals[6];
 Model cubeModel;
 
 void modelInstancePoolReset(ModelInstancePool *pool) 
@@ -22,10 +23,12 @@ void modelInstancePoolReset(ModelInstancePool *pool)
         pool->instances[i].state.__next =  (i+1 < pool->POOL_CAPACITY) ? pool->instances + i + 1 : NULL;
     }
     pool->firstAvailable = pool->instances;
+    pool->instanceCount = 0;
 }
 
-ModelInstancePool modelInstancePoolNew(ModelInstance *buffer, int bufferCapacity) {
-    ModelInstancePool new = {.POOL_CAPACITY=bufferCapacity, .instances=buffer, .firstAvailable=NULL, .instanceCount=0};
+ModelInstancePool modelInstancePoolNew(ModelInstance *buffer, u16 *liveBuffer, int bufferCapacity) {
+    assertion(bufferCapacity <= 0xffff, "model.c: modelInstancePoolNew: bufferCapacity <= 0xffff (for the indices in live)");
+    ModelInstancePool new = {.POOL_CAPACITY=bufferCapacity, .instances=buffer, .firstAvailable=NULL, .instanceCount=0, .live=liveBuffer};
     modelInstancePoolReset(&new);
     return new;
 }
@@ -52,7 +55,17 @@ ModelInstance* modelInstanceAdd(ModelInstancePool *pool,  Model model, const Vec
     new->state.scale.x = scale->x; new->state.scale.y = scale->y; new->state.scale.z = scale->z;
     new->state.shading = shading;
     new->state.backfaceCulling = true;
+    new->state.lodLevel = 0;
+    new->state.morphKeys[0] = new->state.morphKeys[1] = 0;
+    new->state.morphWeight = 0;
 
+    matrix4x4createYawPitchRoll(new->state.__rotMat, yaw, pitch, roll);
+    new->state.__rotMatYaw = yaw;
+    new->state.__rotMatPitch = pitch;
+    new->state.__rotMatRoll = roll;
+
+    new->state.__liveIndex = pool->instanceCount;
+    pool->live[pool->instanceCount] = new - pool->instances;
     pool->instanceCount++;
     return new;
 }
@@ -64,11 +77,31 @@ ModelInstance* modelInstanceAddVanilla(ModelInstancePool *pool,  Model model, co
     return modelInstanceAdd(pool, model, pos, &uniformScale, 0, 0, 0, shading);
 }
 
+/* 
+    Sets the vertex animation of the instance to the given (fractional) key, e.g. int2fx(1) + (int2fx(1) >> 2) is a quarter of the way from key 1 to key 2. 
+    The animation loops: the last key is blended with the first one, and larger keys wrap around.
+*/
+void modelInstanceMorphSet(ModelInstance *instance, FIXED key) 
+{
+    const ModelMorph *morph = instance->state.mod.morph;
+    assertion(morph != NULL && key >= 0, "model.c: modelInstanceMorphSet: morph != NULL && key >= 0");
+    const int from = fx2int(key) % morph->numKeys;
+    instance->state.morphKeys[0] = from;
+    instance->state.morphKeys[1] = from + 1 < morph->numKeys ? from + 1 : 0;
+    instance->state.morphWeight = key & (FIX_SCALE - 1);
+}
+
 int modelInstanceRemove(ModelInstancePool *pool, ModelInstance* instance) 
 { 
     assertion(pool != NULL, "model.c: modelInstancePoolRemove: pool not NULL");
     assertion(instance != NULL, "model.c: modelInstancePoolRemove: instance not NULL");
     assertion(pool->instanceCount > 0, "model.c: modelInstancePoolRemove: instance pool not empty");
+    assertion(!instance->isEmpty, "model.c: modelInstancePoolRemove: instance not empty");
+    // Swap-remove from the live instances (before __next overwrites the instance's state).
+    const int liveIndex = instance->state.__liveIndex;
+    const int lastLive = pool->live[pool->instanceCount - 1];
+    pool->live[liveIndex] = lastLive;
+    pool->instances[lastLive].state.__liveIndex = liveIndex;
     // Prepend the removed/newly available element to the beginning of the free-list. 
     instance->isEmpty = true;
     instance->state.__next = pool->firstAvailable;
@@ -79,18 +112,41 @@ int modelInstanceRemove(ModelInstancePool *pool, ModelInstance* instance)
 }
 
 
-Model modelNew(const Vec3 *verts, const Face *faces, int numVerts, int numFaces) 
+Model modelNew(const ModelVert *verts, const Face *faces, const Vec3 *normals, int numVerts, int numFaces, BoundingSphere bounds) 
 {
     assertion(numVerts <= MAX_MODEL_VERTS, "model.c: modelNew: numVert <= MAX");
     assertion(numFaces <= MAX_MODEL_FACES, "model.c: modelNew: numFaces <= MAX");
-    Model m = {.faces=faces, .verts=verts, .numVerts=numVerts, .numFaces=numFaces};
+    assertion(bounds.radius >= 0, "model.c: modelNew: bounds.radius >= 0");
+    Model m = {.faces=faces, .verts=verts, .normals=normals, .numVerts=numVerts, .numFaces=numFaces, .bounds=bounds};
     return m;
 }
 
+/* 
+    For models which are not generated by obj2model.py (which computes the bounding sphere at build time). 
+    Centered on the axis-aligned bounding box, so not the smallest possible sphere, but close enough for culling. 
+*/
+BoundingSphere modelBoundingSphereCompute(const ModelVert *verts, int numVerts) 
+{
+    assertion(numVerts > 0, "model.c: modelBoundingSphereCompute: numVerts > 0");
+    Vec3 min = {.x=verts[0].x, .y=verts[0].y, .z=verts[0].z}, max = min;
+    for (int i = 1; i < numVerts; ++i) {
+        min.x = MIN(min.x, verts[i].x); max.x = MAX(max.x, verts[i].x);
+        min.y = MIN(min.y, verts[i].y); max.y = MAX(max.y, verts[i].y);
+        min.z = MIN(min.z, verts[i].z); max.z = MAX(max.z, verts[i].z);
+    }
+    BoundingSphere bounds = {.center={.x=(min.x + max.x) / 2, .y=(min.y + max.y) / 2, .z=(min.z + max.z) / 2}, .radius=0};
+    for (int i = 0; i < numVerts; ++i) {
+        const Vec3 vert = {.x=verts[i].x, .y=verts[i].y, .z=verts[i].z};
+        bounds.radius = MAX(bounds.radius, vecMag(vecSub(vert, bounds.center)));
+    }
+    bounds.radius += 1; // vecMag rounds down.
+    return bounds;
+}
+
 void modelInit(void) 
 {
     FIXED half = int2fx(1) >> 2; // quarter?
-    Vec3 verts[8] = {
+    ModelVert verts[8] = {
         // front plane
         {.x = -half, .y = -half, .z = half},
         {.x = -half, .y = half, .z = half},
@@ -103,26 +159,28 @@ void modelInit(void)
         {.x = half, .y = -half, .z = -half},
     };
     memcpy(cubeModelVerts, verts, sizeof(cubeModelVerts));
+    Vec3 normals[6] = {{0, 0, int2fx(1)}, {0, 0, int2fx(-1)}, {int2fx(1), 0, 0}, {int2fx(-1), 0, 0}, {0, int2fx(-1), 0}, {0, int2fx(1), 0}};
+    memcpy(cubeModelNormals, normals, sizeof(cubeModelNormals));
     Face trigs[12] = { // Counter-clockwise winding order.
         // front
-        {.vertexIndex = {0, 3, 2}, .color = CLR_CYAN, .normal={0, 0, int2fx(1)}, .type=TriangleFace}, 
-        {.vertexIndex = {2, 1, 0}, .color = CLR_CYAN, .normal={0, 0, int2fx(1)}, .type=TriangleFace},
+        {.vertexIndex = {0, 3, 2}, .color = CLR_CYAN, .normalIndex = 0}, 
+        {.vertexIndex = {2, 1, 0}, .color = CLR_CYAN, .normalIndex = 0},
         // back
-        {.vertexIndex = {6, 7, 4}, .color = CLR_RED, .normal={0, 0, int2fx(-1)}, .type=TriangleFace},  
-        {.vertexIndex = {4, 5, 6}, .color = CLR_RED, .normal={0, 0, int2fx(-1)}, .type=TriangleFace},  
+        {.vertexIndex = {6, 7, 4}, .color = CLR_RED, .normalIndex = 1},  
+        {.vertexIndex = {4, 5, 6}, .color = CLR_RED, .normalIndex = 1},  
         // right
-        {.vertexIndex = {3, 7, 6}, .color = CLR_BLUE, .normal={int2fx(1), 0, 0}, .type=TriangleFace},
-        {.vertexIndex = {6, 2, 3}, .color = CLR_BLUE, .normal={int2fx(1), 0, 0}, .type=TriangleFace},  
+        {.vertexIndex = {3, 7, 6}, .color = CLR_BLUE, .normalIndex = 2},
+        {.vertexIndex = {6, 2, 3}, .color = CLR_BLUE, .normalIndex = 2},  
         // left
-        {.vertexIndex = {1, 5, 4}, .color = CLR_MAG, .normal={int2fx(-1), 0, 0}, .type=TriangleFace},
-        {.vertexIndex = {4, 0, 1}, .color = CLR_MAG, .normal={int2fx(-1), 0, 0}, .type=TriangleFace},
+        {.vertexIndex = {1, 5, 4}, .color = CLR_MAG, .normalIndex = 3},
+        {.vertexIndex = {4, 0, 1}, .color = CLR_MAG, .normalIndex = 3},
         // bottom
-        {.vertexIndex = {7, 3, 0}, .color = CLR_GREEN, .normal={0, int2fx(-1), 0}, .type=TriangleFace}, 
-        {.vertexIndex = {0, 4, 7}, .color = CLR_GREEN, .normal={0, int2fx(-1), 0}, .type=TriangleFace},
+        {.vertexIndex = {7, 3, 0}, .color = CLR_GREEN, .normalIndex = 4}, 
+        {.vertexIndex = {0, 4, 7}, .color = CLR_GREEN, .normalIndex = 4},
         // top
-        {.vertexIndex = {6, 5, 1}, .color = CLR_YELLOW, .normal={0, int2fx(1), 0}, .type=TriangleFace},
-        {.vertexIndex = {1, 2, 6}, .color = CLR_YELLOW, .normal={0, int2fx(1), 0}, .type=TriangleFace},
+        {.vertexIndex = {6, 5, 1}, .color = CLR_YELLOW, .normalIndex = 5},
+        {.vertexIndex = {1, 2, 6}, .color = CLR_YELLOW, .normalIndex = 5},
     };
     memcpy(cubeModelFaces, trigs, 12 * sizeof(Face));
-    cubeModel = modelNew(cubeModelVerts, cubeModelFaces, 8, 12);
+    cubeModel = modelNew(cubeModelVerts, cubeModelFaces, cubeModelNormals, 8, 12, modelBoundingSphereCompute(cubeModelVerts, 8));
 }
@@ -5,33 +5,95 @@
 #include "math.h"
 #include "raster_geometry.h"
 
-#define MAX_MODEL_VERTS 512
-#define MAX_MODEL_FACES 512
+#define MAX_MODEL_VERTS 1024
+#define MAX_MODEL_FACES 1024
+#define MAX_MODEL_VERT_NORMALS (MAX_MODEL_FACES * 3) // Worst case: every vertex of every face has its own normal (cf. Model.vertNormals).
 
 /*
     We want to use object pools to manage our modelInstances, just a thin abstraction on top of static arrays with no dynamic allocations etc. 
     That means we can add and remove instances in constant time if we want that. 
-    Only disadvantage would be that we have to iterate over empty slots then if we want to draw all and don't want to have a seperate array,
-    (but if we just keep our pools full, or mostly full, they are equivalent to regular arrays in that regard). 
+    To not iterate over the empty slots when we draw all of them, the pool also keeps a seperate (packed) array with the indices of the live instances (cf. ModelInstancePool). 
     cf. https://gameprogrammingpatterns.com/object-pool.html (last retrieved: 2021-05-11)
 */
 
-typedef enum FaceType {
-    TriangleFace, 
-    ConvexPlanarQuadFace
-} FaceType;
+/* 
+    The meshes are read from ROM (with its wait states) every frame, so we keep them compact: 
+    The vertices are .8 fixed point like everything else, but in 16 bits (which limits the coordinates to -128..128; obj2model.py checks that), 
+    and the faces are triangles which only refer to their vertices and normal by index (10 instead of 36 bytes per face). 
+*/
+typedef struct ModelVert {
+    s16 x, y, z;
+} ModelVert;
 
 typedef struct Face {
-    FaceType type;
-    int vertexIndex[4];  // The faces don't save the vertices explicity, but indices to them (as vertices are usually shared among different faces, we save memory.)
-    Vec3 normal;
+    u16 vertexIndex[3];  // The faces don't save the vertices explicity, but indices to them (as vertices are usually shared among different faces, we save memory.)
+    u16 normalIndex; // Into the normals of the model; faces in the same plane share them, so flat shaded models need only a few.
     COLOR color;
 } Face;
 
+/* 
+    A node of the BSP tree of a model (cf. bsp_build in tools/obj2model.py), which lets draw.c draw its faces back to front without sorting them. 
+    The faces of a node lie in its plane (the points p with dot(normal, p) == planeDist), and are contiguous in Model.faces. 
+*/
+typedef struct BspNode {
+    FIXED planeDist;
+    s16 normalX, normalY, normalZ; // Unit normal (.8 fixed point).
+    u16 firstFace, numFaces;
+    s16 front, back; // The child nodes (indices into Model.bspNodes) with the faces in front of/behind the plane, or -1.
+} BspNode;
+
+/* 
+    An edge of a model which is drawn as a wireframe (cf. tools/obj2model.py); edges which are shared by two faces are only stored (and drawn) once. 
+    The faces are needed for backface culling (the edge is visible if one of them is) and the colour (the one of the first visible face). 
+*/
+typedef struct ModelEdge {
+    u16 vertexIndex[2];
+    u16 faceIndex[2]; // The second one is MODEL_EDGE_NO_FACE if the edge is on the border of the mesh.
+} ModelEdge;
+#define MODEL_EDGE_NO_FACE 0xffff
+
+/* 
+    Vertex animation (cf. morph in assets/models/config): the model's vertices are the first key, and every key stores the offsets of all vertices from them 
+    (x, y, z for each vertex, numVerts * 3 per key; the ones of the first key are all zero, so draw.c doesn't need a special case). 
+    An instance is drawn as a blend of two keys (cf. ModelInstance.morphKeys), the faces and normals stay the same, so the lighting and backface culling 
+    use the normals of the first key (keep the keys close to it, e.g. a waving flag or a breathing head, or turn off backface culling). 
+    The offsets are s8 (shifted to the left by deltaShift, which costs some precision) if they fit, otherwise s16 (deltaShift is 0 then). 
+*/
+typedef struct ModelMorph {
+    const s8 *deltas8; // Either this or deltas16 is NULL.
+    const s16 *deltas16;
+    int numKeys;
+    int deltaShift;
+} ModelMorph;
+
+typedef struct BoundingSphere {
+    Vec3 center;
+    FIXED radius;
+} BoundingSphere;
+
 typedef struct Model {
-    const Vec3 *verts;
+    const ModelVert *verts;
     const Face *faces;
+    const Vec3 *normals; // The (unit) face normals, cf. Face.normalIndex. 
     int numVerts, numFaces;
+    BoundingSphere bounds; // In model space (enclosing all keys of morph models); lets us cull whole instances before transforming any of their vertices (cf. draw.c).
+    const Texture *texture; // NULL if the model is not textured.
+    const TexCoord *texCoords; // Three per face (in the order of their vertexIndex), or NULL. 
+    // For SHADING_GOURAUD (or NULL): The vertex normals, and an index into them for each vertex of each face (three per face). 
+    // A vertex can have more than one normal (where it lies on a sharp edge), so the lighting is calculated per vertex normal rather than per vertex. 
+    const Vec3 *vertNormals; 
+    const u16 *faceVertNormals;
+    int numVertNormals;
+    // The BSP tree of the model (the root is the first node), or NULL. Instances of such models are drawn as a whole (cf. draw.c), so they shouldn't intersect other instances.
+    const BspNode *bspNodes; 
+    int numBspNodes;
+    // The unique edges of the model for SHADING_WIREFRAME (or NULL, then the faces are drawn as outlines one by one, i.e. the shared edges twice). 
+    const ModelEdge *edges; 
+    int numEdges;
+    const ModelMorph *morph; // The keys of the vertex animation, or NULL. 
+    // For SHADING_PRELIT (or NULL): The shade (the index into the shade ramp of its colour) of each face lit by a directional light which is fixed relative to the model (cf. prelit in assets/models/config). 
+    const u8 *prelitShades; 
+    const struct Model *lowerDetail; // The next lower level of detail (a model with fewer faces, cf. tools/obj2model.py), or NULL. Drawn once the instance is small enough on the screen (cf. draw.c).
 } Model;
 
 
@@ -76,26 +138,44 @@ typedef struct ModelInstance { // Different Instances share their vertex/face da
             ANGLE_FIXED_12 yaw, pitch, roll;
             PolygonShadingType shading;
             FIXED camSpaceDepth;
+            BoundingSphere worldBounds; // The model's bounds scaled, rotated and translated into world space; updated by drawModelInstancePools every frame.
             bool backfaceCulling;
+            int lodLevel; // The level of detail it was drawn with the last time (0 is mod itself, 1 its lowerDetail etc.)
+            u16 morphKeys[2]; // For models with a ModelMorph: The vertices are morphKeys[0] blended with morphKeys[1] by morphWeight (from 0 to int2fx(1)), cf. modelInstanceMorphSet.
+            FIXED morphWeight;
+            u16 __liveIndex; // Where it is in ModelInstancePool.live.
+            // The rotation matrix (cf. matrix4x4createYawPitchRoll), and the angles it was built from: draw.c only rebuilds it if one of them changed, 
+            // so static instances (and the ones which don't rotate) don't pay for it every frame. 
+            FIXED __rotMat[16]; 
+            ANGLE_FIXED_12 __rotMatYaw, __rotMatPitch, __rotMatRoll;
         }; 
     } ALIGN4 state;
 
 } ALIGN4 ModelInstance;
 
+/* 
+    Besides the free list, a pool keeps the indices of its live instances packed at the start of "live" (instanceCount of them), so drawing a pool only 
+    visits its live instances instead of every slot (pools are sized for the most instances a scene ever has, but are often sparsely filled). 
+    Removing an instance moves the last index into its place, so the order of "live" is the order the instances were added in only as long as none was removed. 
+    The scene provides the buffer for the indices (with as many entries as the instance buffer), cf. modelInstancePoolNew. 
+*/
 typedef struct ModelInstancePool {
     int POOL_CAPACITY; 
     int instanceCount;
     ModelInstance *instances;
     ModelInstance *firstAvailable;
+    u16 *live;
 } ModelInstancePool;
 
 void modelInit(void);
-Model modelNew(const Vec3 *verts, const Face *faces, int numVerts, int numFaces);
-ModelInstancePool modelInstancePoolNew(ModelInstance *buffer, int bufferCapacity);
+Model modelNew(const ModelVert *verts, const Face *faces, const Vec3 *normals, int numVerts, int numFaces, BoundingSphere bounds);
+BoundingSphere modelBoundingSphereCompute(const ModelVert *verts, int numVerts);
+ModelInstancePool modelInstancePoolNew(ModelInstance *buffer, u16 *liveBuffer, int bufferCapacity);
 void modelInstancePoolReset(ModelInstancePool *pool);
 int modelInstanceRemove(ModelInstancePool *pool, ModelInstance* instance);
 ModelInstance* modelInstanceAdd(ModelInstancePool *pool,  Model model, const Vec3 *pos, const Vec3 *scale, ANGLE_FIXED_12 yaw, ANGLE_FIXED_12 pitch, ANGLE_FIXED_12 roll, PolygonShadingType shading);
 ModelInstance* modelInstanceAddVanilla(ModelInstancePool *pool,  Model model, const Vec3 *pos, FIXED scale, PolygonShadingType shading);
+void modelInstanceMorphSet(ModelInstance *instance, FIXED key);
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include <tonc.h>
+
+#include "particles.h"
+#include "math.h"
+#include "logutils.h"
+#include "timer.h"
+
+static int perfUpdate;
+
+void particlesInit(void)
+{
+    perfUpdate = performanceDataRegister("particles.c: update");
+}
+
+ParticlePool particlePoolNew(u32 *buffer, int capacity)
+{
+    assertion(buffer != NULL && capacity > 0, "particles.c: particlePoolNew: buffer != NULL && capacity > 0");
+    ParticlePool pool = {.capacity=capacity, .count=0};
+    FIXED *arrays = (FIXED*)buffer;
+    pool.x = arrays;
+    pool.y = arrays + capacity;
+    pool.z = arrays + capacity * 2;
+    pool.velX = arrays + capacity * 3;
+    pool.velY = arrays + capacity * 4;
+    pool.velZ = arrays + capacity * 5;
+    pool.life = arrays + capacity * 6;
+    pool.color = (COLOR*)(arrays + capacity * 7); // (The end of the buffer, cf. PARTICLE_POOL_BUFFER_WORDS.)
+    return pool;
+}
+
+void particlePoolReset(ParticlePool *pool)
+{
+    pool->count = 0;
+}
+
+int particleAdd(ParticlePool *pool, Vec3 pos, Vec3 vel, FIXED_12 life, COLOR color)
+{
+    if (pool->count == pool->capacity) {
+        return -1;
+    }
+    const int i = pool->count++;
+    pool->x[i] = pos.x;
+    pool->y[i] = pos.y;
+    pool->z[i] = pos.z;
+    pool->velX[i] = vel.x;
+    pool->velY[i] = vel.y;
+    pool->velZ[i] = vel.z;
+    pool->life[i] = life;
+    pool->color[i] = color;
+    return i;
+}
+
+ParticleEmitter particleEmitterNew(Vec3 pos, Vec3 vel, Vec3 velSpread, FIXED_12 life, FIXED_12 lifeSpread, int rate, COLOR color)
+{
+    assertion(velSpread.x >= 0 && velSpread.y >= 0 && velSpread.z >= 0 && lifeSpread >= 0 && lifeSpread < life, "particles.c: particleEmitterNew: valid spreads");
+    ParticleEmitter emitter = {.pos=pos, .vel=vel, .velSpread=velSpread, .life=life, .lifeSpread=lifeSpread, .color=color, .rate=rate, .__pending=0};
+    return emitter;
+}
+
+// A random value in [-spread, spread] (qran_range's range is exclusive).
+INLINE FIXED spreadRandom(FIXED spread)
+{
+    return spread ? qran_range(-spread, spread + 1) : 0;
+}
+
+IWRAM_CODE_ARM void particleEmitterUpdate(ParticleEmitter *emitter, ParticlePool *pool, FIXED_12 deltatime)
+{
+    emitter->__pending += emitter->rate * deltatime;
+    const int num = fx12ToInt(emitter->__pending);
+    emitter->__pending -= int2fx12(num);
+    for (int i = 0; i < num; ++i) {
+        const Vec3 vel = {
+            .x = emitter->vel.x + spreadRandom(emitter->velSpread.x),
+            .y = emitter->vel.y + spreadRandom(emitter->velSpread.y),
+            .z = emitter->vel.z + spreadRandom(emitter->velSpread.z)
+        };
+        if (particleAdd(pool, emitter->pos, vel, emitter->life + spreadRandom(emitter->lifeSpread), emitter->color) < 0) {
+            break;
+        }
+    }
+}
+
+/*
+    Explicit Euler integration with the deltatime of the frame (in .12 fixed point; the product with the .8 velocities is shifted back to .8).
+    Dead particles are overwritten by the last one, which is then checked in the same iteration.
+*/
+IWRAM_CODE_ARM void particlesUpdate(ParticlePool *pool, Vec3 acceleration, FIXED_12 deltatime)
+{
+    performanceStart(perfUpdate);
+    const FIXED dvx = (acceleration.x * deltatime) >> 12, dvy = (acceleration.y * deltatime) >> 12, dvz = (acceleration.z * deltatime) >> 12;
+    FIXED *x = pool->x, *y = pool->y, *z = pool->z;
+    FIXED *velX = pool->velX, *velY = pool->velY, *velZ = pool->velZ;
+    FIXED_12 *life = pool->life;
+    int count = pool->count;
+    for (int i = 0; i < count; ) {
+        if (life[i] != PARTICLE_LIFE_INFINITE) {
+            life[i] -= deltatime;
+            if (life[i] <= 0) {
+                --count;
+                x[i] = x[count]; y[i] = y[count]; z[i] = z[count];
+                velX[i] = velX[count]; velY[i] = velY[count]; velZ[i] = velZ[count];
+                life[i] = life[count];
+                pool->color[i] = pool->color[count];
+                continue;
+            }
+        }
+        velX[i] += dvx; velY[i] += dvy; velZ[i] += dvz;
+        x[i] += (velX[i] * deltatime) >> 12;
+        y[i] += (velY[i] * deltatime) >> 12;
+        z[i] += (velZ[i] * deltatime) >> 12;
+        ++i;
+    }
+    pool->count = count;
+    performanceEnd(perfUpdate);
+}
@@ -0,0 +1,53 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <tonc.h>
+#include "math.h"
+
+/*
+    Particles (stars, sparks etc.) are just points which move in a straight line (plus a common acceleration, e.g. gravity) until their lifetime is over.
+    A pool keeps them as a structure of arrays in a buffer the scene provides (in EWRAM, cf. PARTICLE_POOL_BUFFER_WORDS), so the update and the projection
+    in draw.c (cf. drawParticles) each run over a few contiguous arrays. The living particles are always the first count ones (a dead particle is replaced by the last one),
+    so there are no empty slots to skip, but the order of the particles changes.
+*/
+#define PARTICLE_LIFE_INFINITE INT32_MAX // Particles with that lifetime stay until the pool is reset (e.g. stars).
+
+typedef struct ParticlePool {
+    int capacity, count;
+    FIXED *x, *y, *z; // Position (world space).
+    FIXED *velX, *velY, *velZ; // Velocity (units per second).
+    FIXED_12 *life; // Remaining lifetime (seconds).
+    COLOR *color;
+} ParticlePool;
+
+// The size of the buffer (in words) for a pool of the given capacity.
+#define PARTICLE_POOL_BUFFER_WORDS(capacity) ((capacity) * 7 + ((capacity) + 1) / 2)
+
+/*
+    Emits particles at a fixed rate, with a random velocity (and lifetime) around the given one.
+    Emitted particles are simply dropped once the pool is full.
+*/
+typedef struct ParticleEmitter {
+    Vec3 pos;
+    Vec3 vel, velSpread; // Each component of the velocity is uniformly distributed in [vel - velSpread, vel + velSpread].
+    FIXED_12 life, lifeSpread;
+    COLOR color;
+    int rate; // Particles per second.
+    FIXED_12 __pending; // The fraction of a particle which was due in the last update, so the rate doesn't depend on the frame rate.
+} ParticleEmitter;
+
+void particlesInit(void);
+
+ParticlePool particlePoolNew(u32 *buffer, int capacity);
+void particlePoolReset(ParticlePool *pool);
+
+// Returns the index of the new particle, or -1 if the pool is full.
+int particleAdd(ParticlePool *pool, Vec3 pos, Vec3 vel, FIXED_12 life, COLOR color);
+
+ParticleEmitter particleEmitterNew(Vec3 pos, Vec3 vel, Vec3 velSpread, FIXED_12 life, FIXED_12 lifeSpread, int rate, COLOR color);
+IWRAM_CODE_ARM void particleEmitterUpdate(ParticleEmitter *emitter, ParticlePool *pool, FIXED_12 deltatime);
+
+// Moves all particles by their velocity (which changes by acceleration), and removes the ones whose lifetime is over.
+IWRAM_CODE_ARM void particlesUpdate(ParticlePool *pool, Vec3 acceleration, FIXED_12 deltatime);
+
+#endif
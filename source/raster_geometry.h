@@ -6,26 +6,74 @@
 #include "math.h"
 
 typedef enum PolygonShadingType { 
-    SHADING_FLAT_LIGHTING,
+    SHADING_FLAT_LIGHTING, // Lighting per face, through the shade ramp of its colour.
     SHADING_FLAT,
-    SHADING_WIREFRAME
+    SHADING_WIREFRAME,
+    SHADING_TEXTURED, // Affine texture mapping (the model needs a texture and texture coordinates, cf. tools/obj2model.py).
+    SHADING_TEXTURED_PERSPECTIVE, // Texture mapping which is perspective correct every RASTER_PERSPECTIVE_SPAN pixels, and affine in between.
+    SHADING_GOURAUD, // Lighting per vertex (the model needs vertex normals, cf. tools/obj2model.py), interpolated over the faces through the shade ramp of their colour.
+    SHADING_PRELIT // Flat shading with the colours lit at build time (the model needs them, cf. Model.prelitShades); the light passed to drawModelInstancePools is ignored.
 } PolygonShadingType;
 
+typedef struct Texture {
+    const COLOR *texels;
+    int widthLog2, heightLog2; // The dimensions have to be powers of two, so the texture coordinates can wrap around with a mask. 
+} Texture;
+
+typedef struct TexCoord {
+    FIXED u, v; // In texels (not normalised to [0, 1]).
+} TexCoord;
+
 
 /* 
-    We use RASTER_POINT_NEAR_FAR_CULL as a special value for x and y when the raster point is behind the near plane or beyond the far plane. 
+    We use RASTER_POINT_NEAR_FAR_CULL as a special value for x and y when the raster point is beyond the far plane (faces with such points are culled), 
+    and RASTER_POINT_NEAR_CLIP when it is behind the near plane (faces with such points are clipped against the near plane in camera space before they are projected). 
 */
 #define RASTER_POINT_NEAR_FAR_CULL INT16_MAX
+#define RASTER_POINT_NEAR_CLIP INT16_MIN
+
+#define RASTER_POLYGON_MAX_VERTS 4 // A triangle clipped against the near plane has at most 4 vertices.
 
 typedef struct RasterPoint { 
     s16 x, y; 
 } ALIGN4 RasterPoint; 
 
+#define RASTER_SHADE_RAMP_LEN 32 // A shade ramp goes from black (index 0) to the full colour (index 31).
+
+/* 
+    The per-vertex attributes the rasteriser interpolates over a RasterTriangle (with the same number of vertices); either texturing or Gouraud shading.  
+*/
+typedef struct RasterAttributes {
+    const Texture *texture;
+    TexCoord texCoords[RASTER_POLYGON_MAX_VERTS];
+    s32 invZ[RASTER_POLYGON_MAX_VERTS]; // 1 / z of the vertices in camera space (.16 fixed point); only used for SHADING_TEXTURED_PERSPECTIVE.
+    const COLOR *shadeRamp; // RASTER_SHADE_RAMP_LEN entries.
+    FIXED shades[RASTER_POLYGON_MAX_VERTS]; // Index into the shadeRamp (.8 fixed point, from 0 to 31).
+} RasterAttributes;
+
+// An edge of a model drawn with SHADING_WIREFRAME (already clipped against the screen, cf. draw.c).
+typedef struct RasterLine {
+    RasterPoint a, b;
+    COLOR color;
+} ALIGN4 RasterLine;
+
+/* 
+    Usually a triangle, but faces clipped against the near plane are convex polygons with up to RASTER_POLYGON_MAX_VERTS vertices (in the same winding order). 
+    With numVerts 0, it stands for the numLines lines of the wireframe of an instance with an edge list instead (SHADING_WIREFRAME, cf. edgesPrepareDraw in draw.c), 
+    so they're sorted as a whole. 
+*/
 typedef struct RasterTriangle {
-    RasterPoint vert[3];
+    RasterPoint vert[RASTER_POLYGON_MAX_VERTS];
     FIXED centroidZ;
     COLOR color;
+    u8 numVerts;
+    u16 groupLen; // The number of triangles after this one in the array which are drawn right after it (the faces of an instance with a BSP tree, cf. draw.c), usually 0.
+    u16 numLines;
     PolygonShadingType shading;
+    union {
+        const RasterAttributes *attributes; // Only for textured shading types and SHADING_GOURAUD.
+        const RasterLine *lines; // Only for numVerts 0.
+    };
     struct RasterTriangle* next; // For our ordering table in draw.c
 } ALIGN4 RasterTriangle;
 
@@ -8,7 +8,7 @@
 #include "../logutils.h"
 #include "../model.h"
 
-#define RASTERPOINT_IN_BOUNDS_M5(vert) (vert.x >= 0 && vert.x < M5_SCALED_W && vert.y >= 0 && vert.y < M5_SCALED_H)
+#define RASTERPOINT_IN_BOUNDS(vert) (vert.x >= 0 && vert.x < g_rasterWidth && vert.y >= 0 && vert.y < g_rasterHeight)
 
 typedef enum ClipEdges {
     TOP_EDGE=0,
@@ -38,8 +38,8 @@ static RasterPoint calcIntersect2d(ClipEdges edge, RasterPoint current, RasterPo
         case RIGHT_EDGE:
             assertion(current.x - prev.x !=0, "calcIntersect div 0");
             slope = fxdiv(int2fx(current.y - prev.y), int2fx(current.x - prev.x));
-            inter.x = M5_SCALED_W - 1;
-            inter.y = fx2int(fxmul(slope, int2fx(M5_SCALED_W - 1) - int2fx(prev.x)) + int2fx(prev.y));
+            inter.x = g_rasterWidth - 1;
+            inter.y = fx2int(fxmul(slope, int2fx(g_rasterWidth - 1) - int2fx(prev.x)) + int2fx(prev.y));
             break;
         case TOP_EDGE:
             assertion(current.y - prev.y !=0, "calcIntersect div 0");
@@ -50,8 +50,8 @@ static RasterPoint calcIntersect2d(ClipEdges edge, RasterPoint current, RasterPo
         case BOTTOM_EDGE:
             assertion(current.y - prev.y !=0, "calcIntersect div 0");
             invslope = fxdiv(int2fx(current.x - prev.x), int2fx(current.y - prev.y));
-            inter.y = M5_SCALED_H - 1;
-            inter.x = fx2int(fxmul(int2fx(M5_SCALED_H - 1) - int2fx(prev.y), invslope) + int2fx(prev.x));
+            inter.y = g_rasterHeight - 1;
+            inter.x = fx2int(fxmul(int2fx(g_rasterHeight - 1) - int2fx(prev.y), invslope) + int2fx(prev.x));
             break;
         default:
             panic("calcIntersect: unknown edge");
@@ -73,13 +73,13 @@ INLINE bool inside_clip(RasterPoint point, ClipEdges edge)
             return point.y >= 0; 
             break;
         case BOTTOM_EDGE:
-            return point.y < M5_SCALED_H;
+            return point.y < g_rasterHeight;
             break;
         case LEFT_EDGE: 
             return point.x >= 0;
             break;
         case RIGHT_EDGE:
-            return point.x < M5_SCALED_W;
+            return point.x < g_rasterWidth;
             break;
         default:
             panic("unknown clipping edge");
@@ -121,17 +121,75 @@ int clipTriangleVerts2d(RasterPoint outputVertices[CLIPPING_MAX_POLY_LEN])
         Checking for out-of-screen vertices while we haven't constructed the final outputVertices array *does not make sense* due to the nature of S-H-clipping. 
     */ 
     for (int i = 0; i < outputLen; ++i) { 
-        assertion(RASTERPOINT_IN_BOUNDS_M5(outputVertices[i]), "draw.c: clipTriangleVerts2d: Vertex within screen bounds");
+        assertion(RASTERPOINT_IN_BOUNDS(outputVertices[i]), "draw.c: clipTriangleVerts2d: Vertex within screen bounds");
     }
     return outputLen; 
 }
 
+/* 
+    Returns the intersection of the line from a to b with the near plane (and interpolates the texture coordinates if given). 
+    We interpolate with 64-bit intermediates, as the edges can be long compared to the near distance, and every error is magnified by the projection afterwards.
+*/
+static Vec3 calcIntersectNear(Vec3 a, Vec3 b, FIXED near, int idxA, int idxB, const RasterAttributes *attribs, RasterAttributes *outputAttribs, int outputIdx) 
+{
+    const FIXED dz = b.z - a.z;
+    assertion(dz != 0, "clipping.c: calcIntersectNear: dz != 0");
+    const s64 t = -near - a.z; // Multiplied by (b - a) and divided by dz.
+    Vec3 inter = {
+        .x = a.x + (FIXED)(t * (b.x - a.x) / dz),
+        .y = a.y + (FIXED)(t * (b.y - a.y) / dz),
+        .z = -near
+    };
+    if (attribs) {
+        const TexCoord *texA = attribs->texCoords + idxA, *texB = attribs->texCoords + idxB;
+        outputAttribs->texCoords[outputIdx].u = texA->u + (FIXED)(t * (texB->u - texA->u) / dz);
+        outputAttribs->texCoords[outputIdx].v = texA->v + (FIXED)(t * (texB->v - texA->v) / dz);
+        outputAttribs->shades[outputIdx] = attribs->shades[idxA] + (FIXED)(t * (attribs->shades[idxB] - attribs->shades[idxA]) / dz);
+    }
+    return inter;
+}
+
+Vec3 clipLineNearPlane(Vec3 a, Vec3 b, FIXED near) 
+{
+    return calcIntersectNear(a, b, near, 0, 1, NULL, NULL, 0);
+}
+
+int clipTriangleNearPlane(const Vec3 triangle[3], const RasterAttributes *attribs, Vec3 outputVertices[RASTER_POLYGON_MAX_VERTS], RasterAttributes *outputAttribs, FIXED near) 
+{
+    assertion(!attribs || attribs != outputAttribs, "clipping.c: clipTriangleNearPlane: attribs != outputAttribs");
+    int outputLen = 0;
+    for (int i = 0; i < 3; ++i) {
+        const int prevIdx = i, currentIdx = i + 1 < 3 ? i + 1 : 0;
+        const Vec3 prev = triangle[prevIdx];
+        const Vec3 current = triangle[currentIdx];
+        const bool currentInside = current.z <= -near;
+        const bool prevInside = prev.z <= -near;
+        if (currentInside) {
+            if (!prevInside) {
+                outputVertices[outputLen] = calcIntersectNear(prev, current, near, prevIdx, currentIdx, attribs, outputAttribs, outputLen);
+                ++outputLen;
+            }
+            if (attribs) {
+                outputAttribs->texCoords[outputLen] = attribs->texCoords[currentIdx];
+                outputAttribs->shades[outputLen] = attribs->shades[currentIdx];
+            }
+            outputVertices[outputLen++] = current;
+        } else if (prevInside) {
+            outputVertices[outputLen] = calcIntersectNear(prev, current, near, prevIdx, currentIdx, attribs, outputAttribs, outputLen);
+            ++outputLen;
+        }
+    }
+    assertion(outputLen <= RASTER_POLYGON_MAX_VERTS, "clipping.c: clipTriangleNearPlane: outputLen <= RASTER_POLYGON_MAX_VERTS");
+    return outputLen;
+}
 
 /* 
     The following code is copied more or less line by line (no pun intended) from the English wikipedia article
     on Cohen-Sutherland line-cliping (with minor modifications), and therefore licensed under the
     "Creative Commons Attribution-ShareAlike 3.0 Unported License".
     cf. https://en.wikipedia.org/wiki/Cohen–Sutherland_algorithm (retrieved 2021-05-10)
+    (The intersections are computed with one integer division each (and 64-bit products, the points can be far off the screen) instead of a fixed point slope, 
+    which was both slower and less accurate.)
  */
 typedef int OutCode;
 static const int INSIDE = 0; // 0000
@@ -145,18 +203,18 @@ INLINE OutCode computeOutcode(const RasterPoint *a)
     OutCode code = INSIDE; 
     if (a->x < 0) {
         code |= LEFT;
-    } else if (a->x >= M5_SCALED_W) {
+    } else if (a->x >= g_rasterWidth) {
         code |= RIGHT;
     }
     if (a->y < 0) {
         code |= TOP;
-    } else if (a->y >= M5_SCALED_H) {
+    } else if (a->y >= g_rasterHeight) {
         code |= BOTTOM;
     }
     return code;
 }
 
-bool clipLineCohenSutherland(RasterPoint *a, RasterPoint *b) 
+IWRAM_CODE_ARM bool clipLineCohenSutherland(RasterPoint *a, RasterPoint *b) 
 {  
     OutCode outcodeA = computeOutcode(a);
     OutCode outcodeB = computeOutcode(b);
@@ -169,21 +227,21 @@ bool clipLineCohenSutherland(RasterPoint *a, RasterPoint *b)
             return false;
         } 
         OutCode outside = outcodeA > outcodeB ? outcodeA : outcodeB; // One of the vertices must be outside, select that one. 
-        int x, y;
+        int x = 0, y = 0;
         if (outside & TOP) {
             // (x2 - x1) / (y2 - y1) = (x - x1) / (y - y1)  
             y = 0;
-            x = a->x + fx2int(fxmul(fxdiv(int2fx(b->x - a->x), int2fx(b->y - a->y)), 0 - int2fx(a->y)));
+            x = a->x + (int)((s64)(b->x - a->x) * (y - a->y) / (b->y - a->y));
         } else if (outside & BOTTOM) {
-            y = M5_SCALED_H - 1;
-            x = a->x + fx2int(fxmul(fxdiv(int2fx(b->x - a->x), int2fx(b->y - a->y)), int2fx(y) - int2fx(a->y)));
+            y = g_rasterHeight - 1;
+            x = a->x + (int)((s64)(b->x - a->x) * (y - a->y) / (b->y - a->y));
         } else if (outside & LEFT) {
             // (y2 - y1) / (x2 - x1) = (y - y1) / (x - x1) 
             x = 0;
-            y = a->y + fx2int(fxmul(fxdiv(int2fx(b->y - a->y), int2fx(b->x - a->x)), int2fx(x) - int2fx(a->x)));
+            y = a->y + (int)((s64)(b->y - a->y) * (x - a->x) / (b->x - a->x));
         } else if (outside & RIGHT) {
-            x = M5_SCALED_W - 1;
-            y = a->y + fx2int(fxmul(fxdiv(int2fx(b->y - a->y), int2fx(b->x - a->x)), int2fx(x) - int2fx(a->x)));
+            x = g_rasterWidth - 1;
+            y = a->y + (int)((s64)(b->y - a->y) * (x - a->x) / (b->x - a->x));
         } else {
             panic("clipping.c: clipLineCohenSutherland: Programming error; no clip intersection.");
         }
@@ -12,6 +12,16 @@
 */
 int clipTriangleVerts2d(RasterPoint outputVertices[CLIPPING_MAX_POLY_LEN]); 
 
+/*
+    Sutherland-Hodgman clipping of a triangle in camera space against the near plane (z = -near). 
+    Writes the vertices of the clipped polygon into outputVertices (in the same winding order), and returns their number (0, 3 or 4). 
+    If attribs is not NULL, the texture coordinates and shades of the clipped polygon are interpolated into outputAttribs (which must not be the same as attribs). 
+*/
+int clipTriangleNearPlane(const Vec3 triangle[3], const RasterAttributes *attribs, Vec3 outputVertices[RASTER_POLYGON_MAX_VERTS], RasterAttributes *outputAttribs, FIXED near);
+
+/* Returns the point (in camera space) where the line from a (in front of the near plane z = -near) to b (behind it) crosses the near plane. */
+Vec3 clipLineNearPlane(Vec3 a, Vec3 b, FIXED near);
+
 /* Returns true if the resulting line is visible on the screen. */
 bool clipLineCohenSutherland(RasterPoint *a, RasterPoint *b);
 
@@ -4,6 +4,7 @@
 #include "../math.h"
 #include "../camera.h"
 #include "../model.h"
+#include "../particles.h"
 #include "../raster_geometry.h"
 
 void drawInit(void);
@@ -18,9 +19,24 @@ void m5ScaledFill(COLOR clr);
 void videoM4Init(void); 
 void setM4Pal(COLOR *pal, int n);
 
+/* 
+    How drawModelInstancePools resolves visibility: 
+    - DRAW_HSR_ORDERING_TABLE (default): painter's algorithm, the polygons are drawn from back to front. 
+    - DRAW_HSR_SBUFFER: the polygons are drawn from front to back through a span buffer (cf. render/sbuffer.h), which writes every pixel at most once. 
+      Wireframe polygons are drawn afterwards (back to front), so they're never hidden by filled polygons in this mode. 
+*/
+typedef enum DrawHiddenSurfaceRemoval {
+    DRAW_HSR_ORDERING_TABLE,
+    DRAW_HSR_SBUFFER
+} DrawHiddenSurfaceRemoval;
+
+void drawSetHiddenSurfaceRemoval(DrawHiddenSurfaceRemoval hsr);
+DrawHiddenSurfaceRemoval drawGetHiddenSurfaceRemoval(void);
+
 /* drawBefore is assumed to be called every frame before the other draw functions are invoked. */
 void drawBefore(Camera *cam);
 void drawModelInstancePools(ModelInstancePool *pools, int numPools, Camera *cam, ModelDrawLightingData lightDat); 
 void drawPoints(const Camera *cam, Vec3 *points, int num, COLOR clr);
+void drawParticles(const Camera *cam, const ParticlePool *pool, FIXED size);
 
 #endif
\ No newline at end of file
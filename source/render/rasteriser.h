@@ -4,6 +4,8 @@
 #include <tonc.h>
 #include "../globals.h"
 #include "../raster_geometry.h"
+#include "../math.h"
+#include "sbuffer.h"
 
 /*  
     Credits of the triangle rasterisation code: Mats Byggmastar (a.k.a. MRI / Doomsday)
@@ -16,8 +18,8 @@
  
 #define FIXED_16_2_INT_CEIL(n) ((n + 0xffff) >> 16)
 typedef int FIXED_16;
-static const RasterPoint* left_array[3];
-static const RasterPoint* right_array[3];
+static const RasterPoint* left_array[RASTER_POLYGON_MAX_VERTS];
+static const RasterPoint* right_array[RASTER_POLYGON_MAX_VERTS];
 static int left_section_idx, right_section_idx;
 static int left_section_height, right_section_height;
 static FIXED_16 left_x, delta_left_x, right_x, delta_right_x; // Those are in .16 fixed point as opposed to our default .8 (Better accuracy).
@@ -29,14 +31,14 @@ INLINE int calcRightSection(void) {
     if (height == 0) {
         return 0;
     }
-    delta_right_x = ((v2->x - v1->x) << 16) / height;
+    delta_right_x = idivFast((v2->x - v1->x) << 16, height);
 
     right_x = (v1->x << 16);
     int dy = MAX(0, v1->y) - v1->y; // Vertical "clipping".
     if (dy) {
         right_x += dy * delta_right_x;
     }
-    return right_section_height = MIN(M5_SCALED_H, v2->y) - MAX(0, v1->y);
+    return right_section_height = MIN(g_rasterHeight, v2->y) - MAX(0, v1->y);
 }
 
 INLINE int calcLeftSection(void) {
@@ -47,15 +49,26 @@ INLINE int calcLeftSection(void) {
     if (height == 0) {
         return 0;
     }
-    delta_left_x = ((v2->x - v1->x) << 16) / height;
+    delta_left_x = idivFast((v2->x - v1->x) << 16, height);
     left_x = (v1->x << 16);
     int dy = MAX(0, v1->y) - v1->y; // Vertical "clipping".
     if (dy) {
         left_x += dy * delta_left_x;
     }
-    return left_section_height = MIN(M5_SCALED_H, v2->y) - MAX(0, v1->y);
+    return left_section_height = MIN(g_rasterHeight, v2->y) - MAX(0, v1->y);
 }
 
+// Hand-written span filler (cf. asm/spanfill16.s; the host build uses a C version in host/shim/asm_shim.c). 
+void spanFill16(u16 *dst, u32 fill, uint count);
+
+// #define RASTER_SPAN_FILL_MEMSET16 // Fill the spans with libtonc's memset16 instead (to compare them with the performance counters, cf. "draw.c: rasterisation").
+
+/* 
+    Spans with at least RASTER_SPAN_DMA_MIN_LEN pixels are filled by DMA3 if defined. It's off by default: VRAM only has a 16-bit bus, so the stmia bursts of spanFill16 
+    take about as many cycles per pixel as a 32-bit DMA fill (which has to read its fixed source for every word as well), and we'd have to pay for the DMA setup. 
+*/
+// #define RASTER_SPAN_DMA_MIN_LEN 96
+
 /* 
     A version of m5_hline (libtonc) which does not normalise x1 and x2, i.e. just assumes x1 < x2. 
     It is measurably faster because it's called so often, and we can guarantee x1 < x2 (If I'm not wrong).
@@ -64,7 +77,304 @@ INLINE int calcLeftSection(void) {
 INLINE void m5_hline_nonorm(int x1, int y, int x2, COLOR clr) 
 {
     u16 *dstL= (u16*)((u8*)vid_page+y*(M5_WIDTH<<1) + x1*2);
+    #ifdef RASTER_SPAN_FILL_MEMSET16
     memset16(dstL, clr, x2-x1+1);
+    #else
+    uint count = x2 - x1 + 1;
+    #if defined(RASTER_SPAN_DMA_MIN_LEN) && !defined(HOST_BUILD)
+    if (count >= RASTER_SPAN_DMA_MIN_LEN) {
+        const u32 fill = dup16(clr);
+        if ((u32)dstL & 2) { // DMA_32 needs word alignment.
+            *dstL++ = clr;
+            --count;
+        }
+        dma3_fill(dstL, fill, (count >> 1) | DMA_32);
+        if (count & 1) {
+            dstL[count - 1] = clr;
+        }
+        return;
+    }
+    #endif
+    spanFill16(dstL, dup16(clr), count);
+    #endif
+}
+
+/*
+    The mode 4 version of m5_hline_nonorm (same invariant). VRAM can't be written bytewise, so the pixels at odd/even ends of the span
+    are read-modified-written, and everything in between is filled two pixels at a time by the same span filler as in mode 5.
+*/
+INLINE void m4_hline_nonorm(int x1, int y, int x2, u8 clrid)
+{
+    u16 *dst = (u16*)((u8*)vid_page + y * M4_WIDTH + (x1 & ~1));
+    if (x1 & 1) { // The left end is the high byte of its halfword.
+        *dst = (*dst & 0x00ff) | (clrid << 8);
+        ++dst;
+        if (++x1 > x2) {
+            return;
+        }
+    }
+    const uint pairs = (x2 - x1 + 1) >> 1;
+    if (pairs) {
+        spanFill16(dst, dup16(dup8(clrid)), pairs);
+    }
+    if (!(x2 & 1)) { // The right end is the low byte of its halfword.
+        dst[pairs] = (dst[pairs] & 0xff00) | clrid;
+    }
+}
+
+/* 
+    Texture mapping: Instead of interpolating the texture coordinates along the edges (like fatmap.txt does), we use the plane equations of the 
+    texture coordinates in screen space (their gradients are constant for the whole polygon), which we can evaluate at the start of any span. 
+    That way, the flat edge walkers below can draw textured polygons, too, and the span buffer can hand us arbitrary visible parts of a span. 
+    For perspective correct mapping, u/z, v/z and 1/z are the ones which are linear in screen space; we divide every RASTER_PERSPECTIVE_SPAN pixels, and interpolate linearly in between. 
+*/
+#define RASTER_PERSPECTIVE_SPAN_SHIFT 3
+#define RASTER_PERSPECTIVE_SPAN (1 << RASTER_PERSPECTIVE_SPAN_SHIFT)
+#define RASTER_PERSPECTIVE_GRADIENT_SHIFT 6 // Additional fractional bits for 1/z, u/z and v/z while we step along the spans.
+
+typedef struct RasterTextureState {
+    const COLOR *texels; // NULL if we don't draw a textured polygon. 
+    int widthMask, heightMask, widthLog2;
+    bool perspective;
+    int x0, y0; // The screen coordinates the planes are relative to.
+    FIXED_16 u0, v0, dudx, dudy, dvdx, dvdy; // Affine mapping (in texels).
+    s32 q0, uq0, vq0, dqdx, dqdy, duqdx, duqdy, dvqdx, dvqdy; // Perspective correct mapping: q is 1/z (.16), uq and vq are u/z and v/z (.16 fixed point texels times 1/z), all with RASTER_PERSPECTIVE_GRADIENT_SHIFT additional bits. 
+} RasterTextureState;
+
+static RasterTextureState rasterTex = {.texels = NULL};
+
+/* 
+    Gouraud shading: The shade (an index into the shade ramp of the polygon's colour) is interpolated with a plane equation just like the texture coordinates above, 
+    so we only step one .16 fixed point value per pixel, and look up the colour. 
+*/
+typedef struct RasterShadeState {
+    const COLOR *ramp; // NULL if we don't draw a Gouraud shaded polygon. 
+    int x0, y0;
+    FIXED_16 shade0, dsdx, dsdy;
+} RasterShadeState;
+
+static RasterShadeState rasterShade = {.ramp = NULL};
+
+/* 
+    If set, the rasterisers draw their spans through the span buffer (cf. sbuffer.h), which only draws the parts that are not occupied yet by polygons closer to the camera.  
+    (The polygons have to be drawn from front to back in that case.)
+*/
+static bool rasterUseSBuffer = false;
+
+/*
+    If set, the spans are drawn into a mode 4 page (g_rasterWidth x g_rasterHeight, 8bpp) instead of a scaled mode 5 one (cf. drawModelInstancePools).
+    The polygon colours and shade ramps hold palette indices then.
+*/
+static bool rasterM4 = false;
+
+#define RASTER_TEXEL(u, v) rasterTex.texels[((((v) >> 16) & rasterTex.heightMask) << rasterTex.widthLog2) | (((u) >> 16) & rasterTex.widthMask)]
+
+INLINE void rasterTexturedSpanAffine(int x1, int y, int x2) 
+{
+    u16 *dst = (u16*)vid_page + y * M5_WIDTH + x1;
+    const int dx = x1 - rasterTex.x0, dy = y - rasterTex.y0;
+    FIXED_16 u = rasterTex.u0 + dx * rasterTex.dudx + dy * rasterTex.dudy;
+    FIXED_16 v = rasterTex.v0 + dx * rasterTex.dvdx + dy * rasterTex.dvdy;
+    const FIXED_16 dudx = rasterTex.dudx, dvdx = rasterTex.dvdx;
+    for (int n = x2 - x1 + 1; n > 0; --n) {
+        *dst++ = RASTER_TEXEL(u, v);
+        u += dudx;
+        v += dvdx;
+    }
+}
+
+// Returns u and v (.16 fixed point texels) from u/z, v/z and 1/z; we use the reciprocal LUT (cf. math.h) instead of dividing.
+INLINE void rasterPerspectiveDivide(s32 uq, s32 vq, s32 q, FIXED_16 *u, FIXED_16 *v) 
+{
+    const s32 r = fxReciprocalFast(MAX(q >> RASTER_PERSPECTIVE_GRADIENT_SHIFT, 1 << 8)); // 2^32 / q; q is at least 2^8 within polygons with z < 256, the MAX only guards against rounding at the edges.
+    *u = (FIXED_16)(((s64)(uq >> RASTER_PERSPECTIVE_GRADIENT_SHIFT) * r) >> 16);
+    *v = (FIXED_16)(((s64)(vq >> RASTER_PERSPECTIVE_GRADIENT_SHIFT) * r) >> 16);
+}
+
+// The divisions happen at multiples of RASTER_PERSPECTIVE_SPAN in screen space (not relative to the span's start), so we only ever interpolate over whole segments (no division for the remainder), 
+// and a span split up by the s-buffer is drawn with exactly the same texels as the whole span. 
+INLINE void rasterTexturedSpanPerspective(int x1, int y, int x2) 
+{
+    u16 *dst = (u16*)vid_page + y * M5_WIDTH + x1;
+    int x = x1 & ~(RASTER_PERSPECTIVE_SPAN - 1);
+    const int dx = x - rasterTex.x0, dy = y - rasterTex.y0;
+    s32 q = rasterTex.q0 + dx * rasterTex.dqdx + dy * rasterTex.dqdy;
+    s32 uq = rasterTex.uq0 + dx * rasterTex.duqdx + dy * rasterTex.duqdy;
+    s32 vq = rasterTex.vq0 + dx * rasterTex.dvqdx + dy * rasterTex.dvqdy;
+    const s32 dqdxSpan = rasterTex.dqdx << RASTER_PERSPECTIVE_SPAN_SHIFT;
+    const s32 duqdxSpan = rasterTex.duqdx << RASTER_PERSPECTIVE_SPAN_SHIFT;
+    const s32 dvqdxSpan = rasterTex.dvqdx << RASTER_PERSPECTIVE_SPAN_SHIFT;
+    FIXED_16 u, v;
+    rasterPerspectiveDivide(uq, vq, q, &u, &v);
+    int skip = x1 - x; // Only the first segment starts in its middle. 
+    while (x <= x2) {
+        q += dqdxSpan;
+        uq += duqdxSpan;
+        vq += dvqdxSpan;
+        FIXED_16 uNext, vNext;
+        rasterPerspectiveDivide(uq, vq, q, &uNext, &vNext);
+        const FIXED_16 dudx = (uNext - u) >> RASTER_PERSPECTIVE_SPAN_SHIFT;
+        const FIXED_16 dvdx = (vNext - v) >> RASTER_PERSPECTIVE_SPAN_SHIFT;
+        u += skip * dudx;
+        v += skip * dvdx;
+        for (int n = MIN(x2 - x + 1, RASTER_PERSPECTIVE_SPAN) - skip; n > 0; --n) {
+            *dst++ = RASTER_TEXEL(u, v);
+            u += dudx;
+            v += dvdx;
+        }
+        skip = 0;
+        u = uNext;
+        v = vNext;
+        x += RASTER_PERSPECTIVE_SPAN;
+    }
+}
+
+#undef RASTER_TEXEL
+
+INLINE void rasterGouraudSpan(int x1, int y, int x2) 
+{
+    u16 *dst = (u16*)vid_page + y * M5_WIDTH + x1;
+    const COLOR *ramp = rasterShade.ramp;
+    const FIXED_16 dsdx = rasterShade.dsdx;
+    FIXED_16 shade = rasterShade.shade0 + (x1 - rasterShade.x0) * dsdx + (y - rasterShade.y0) * rasterShade.dsdy;
+    const FIXED_16 shadeEnd = shade + (x2 - x1) * dsdx;
+    if ((u32)shade < (RASTER_SHADE_RAMP_LEN << 16) && (u32)shadeEnd < (RASTER_SHADE_RAMP_LEN << 16)) { // The shade is linear along the span, so it's in range if both ends are.
+        for (int n = x2 - x1 + 1; n > 0; --n) {
+            *dst++ = ramp[shade >> 16];
+            shade += dsdx;
+        }
+    } else { // The vertices of clipped polygons are rounded to the pixel grid, so the plane can overshoot the ramp a little at their edges. 
+        for (int n = x2 - x1 + 1; n > 0; --n) {
+            *dst++ = ramp[CLAMP(shade >> 16, 0, RASTER_SHADE_RAMP_LEN)];
+            shade += dsdx;
+        }
+    }
+}
+
+/*
+    The mode 4 version: we write two pixels per halfword (the ends are read-modified-written like in m4_hline_nonorm).
+    Instead of clamping every pixel, we clamp the ends of the span and interpolate between those if it overshoots the ramp.
+*/
+INLINE void rasterGouraudSpanM4(int x1, int y, int x2)
+{
+    u16 *dst = (u16*)((u8*)vid_page + y * M4_WIDTH + (x1 & ~1));
+    const COLOR *ramp = rasterShade.ramp;
+    FIXED_16 dsdx = rasterShade.dsdx;
+    FIXED_16 shade = rasterShade.shade0 + (x1 - rasterShade.x0) * dsdx + (y - rasterShade.y0) * rasterShade.dsdy;
+    FIXED_16 shadeEnd = shade + (x2 - x1) * dsdx;
+    if ((u32)shade >= (RASTER_SHADE_RAMP_LEN << 16) || (u32)shadeEnd >= (RASTER_SHADE_RAMP_LEN << 16)) {
+        shade = CLAMP(shade, 0, RASTER_SHADE_RAMP_LEN << 16);
+        shadeEnd = CLAMP(shadeEnd, 0, RASTER_SHADE_RAMP_LEN << 16);
+        dsdx = x2 > x1 ? (shadeEnd - shade) / (x2 - x1) : 0; // Truncated, so we never step past shadeEnd.
+    }
+    if (x1 & 1) {
+        *dst = (*dst & 0x00ff) | (ramp[shade >> 16] << 8);
+        ++dst;
+        shade += dsdx;
+        ++x1;
+    }
+    for (int n = (x2 - x1 + 1) >> 1; n > 0; --n) {
+        const COLOR lo = ramp[shade >> 16];
+        shade += dsdx;
+        *dst++ = lo | (ramp[shade >> 16] << 8);
+        shade += dsdx;
+    }
+    if (x1 <= x2 && !(x2 & 1)) {
+        *dst = (*dst & 0xff00) | ramp[shade >> 16];
+    }
+}
+
+/*
+    Bresenham's line algorithm for the wireframes, in place of libtonc's m5_line/m4_line: both ends have to be on the screen already (cf. clipLineCohenSutherland),
+    and we step through the frame buffer by offsets instead of computing the address of every pixel. The lines are drawn from left to right,
+    so the minor axis is the only one which can go backwards.
+    cf. https://en.wikipedia.org/wiki/Bresenham%27s_line_algorithm (last retrieved 2021-08-24)
+*/
+#define RASTER_LINE_LOOP(PLOT, STRIDE)                              \
+    if (dx >= dy) {                                                 \
+        int err = 2 * dy - dx;                                      \
+        for (int i = 0; i <= dx; ++i) {                             \
+            PLOT;                                                   \
+            if (err >= 0) {                                         \
+                ofs += ystep * (STRIDE);                            \
+                err -= 2 * dx;                                      \
+            }                                                       \
+            err += 2 * dy;                                          \
+            ++ofs;                                                  \
+        }                                                           \
+    } else {                                                        \
+        int err = 2 * dx - dy;                                      \
+        for (int i = 0; i <= dy; ++i) {                             \
+            PLOT;                                                   \
+            if (err >= 0) {                                         \
+                ++ofs;                                              \
+                err -= 2 * dy;                                      \
+            }                                                       \
+            err += 2 * dx;                                          \
+            ofs += ystep * (STRIDE);                                \
+        }                                                           \
+    }                                                               \
+
+INLINE void rasterLine(const RasterLine *line)
+{
+    RasterPoint a = line->a, b = line->b;
+    if (a.x > b.x) {
+        a = line->b;
+        b = line->a;
+    }
+    const int dx = b.x - a.x, dy = ABS(b.y - a.y);
+    const int ystep = b.y < a.y ? -1 : 1;
+    if (rasterM4) { // VRAM can't be written bytewise, so every pixel is a read-modify-write of its halfword (as in m4_hline_nonorm).
+        u8 *const dst = (u8*)vid_page;
+        const u16 clrid = line->color;
+        int ofs = a.y * M4_WIDTH + a.x;
+        RASTER_LINE_LOOP({
+            u16 *px = (u16*)(dst + (ofs & ~1));
+            *px = (ofs & 1) ? (*px & 0x00ff) | (clrid << 8) : (*px & 0xff00) | clrid;
+        }, M4_WIDTH)
+    } else {
+        u16 *const dst = (u16*)vid_page;
+        const COLOR clr = line->color;
+        int ofs = a.y * M5_WIDTH + a.x;
+        RASTER_LINE_LOOP(dst[ofs] = clr, M5_WIDTH)
+    }
+}
+#undef RASTER_LINE_LOOP
+
+INLINE void rasterFillSpan(int x1, int y, int x2, COLOR clr)
+{
+    if (rasterM4) { // (No textures in mode 4, cf. drawModelInstancePools.)
+        if (rasterShade.ramp) {
+            rasterGouraudSpanM4(x1, y, x2);
+        } else {
+            m4_hline_nonorm(x1, y, x2, clr);
+        }
+    } else if (rasterTex.texels) {
+        if (rasterTex.perspective) {
+            rasterTexturedSpanPerspective(x1, y, x2);
+        } else {
+            rasterTexturedSpanAffine(x1, y, x2);
+        }
+    } else if (rasterShade.ramp) {
+        rasterGouraudSpan(x1, y, x2);
+    } else {
+        m5_hline_nonorm(x1, y, x2, clr);
+    }
+}
+
+INLINE void rasterSpan(int x1, int y, int x2, COLOR clr) 
+{
+    if (rasterUseSBuffer) {
+        if (x1 <= x2) { // Empty spans would corrupt the span buffer.
+            SBufferSpan visible[SBUFFER_MAX_SPANS + 1];
+            const int numVisible = sbufferInsertSpan(x1, y, x2, visible);
+            for (int i = 0; i < numVisible; ++i) {
+                rasterFillSpan(visible[i].start, y, visible[i].end, clr);
+            }
+        }
+    } else {
+        rasterFillSpan(x1, y, x2, clr);
+    }
 }
 
 INLINE void drawTriangleFlatByggmastar(const RasterTriangle *tri) 
@@ -84,9 +394,10 @@ INLINE void drawTriangleFlatByggmastar(const RasterTriangle *tri)
         const RasterPoint *tmp = v2; v2 = v3; v3 = tmp;
     }
 
-    if (v1->y >= M5_SCALED_H - 1) { // Triangle certainly invisible. 
+    if (v1->y >= g_rasterHeight - 1) { // Triangle certainly invisible. 
         return;
     }
+    const int width = g_rasterWidth;
 
     int height = v3->y - v1->y;
     if (height == 0) { // Degenerate triangle.
@@ -152,8 +463,8 @@ INLINE void drawTriangleFlatByggmastar(const RasterTriangle *tri)
     while (1) {
         const int x1 = FIXED_16_2_INT_CEIL(left_x);
         const int x2 = FIXED_16_2_INT_CEIL(right_x) - 1;
-        if (!(x1 < 0 &&  x2 < 0) && !(x1 >= M5_SCALED_W && x2 >= M5_SCALED_W)) { // Horizontal "clipping": Don't draw if *both* x-positions are either to the left, or both are to the right of the screen.
-            m5_hline_nonorm(MAX(0, x1), y, MIN(M5_SCALED_W - 1, x2), tri->color);
+        if (!(x1 < 0 &&  x2 < 0) && !(x1 >= width && x2 >= width) && x1 <= x2) { // Horizontal "clipping": Don't draw if *both* x-positions are either to the left, or both are to the right of the screen (or if the span is empty, which spanFill16 can't handle).
+            rasterSpan(MAX(0, x1), y, MIN(width - 1, x2), tri->color);
         }
       
         if (--left_section_height <= 0) { // Check if we've reached the bottom of the left section. 
@@ -176,4 +487,198 @@ INLINE void drawTriangleFlatByggmastar(const RasterTriangle *tri)
     }
 }
 
+/* 
+    The same edge walker as above, but for convex polygons (e.g. triangles clipped against the near plane). 
+    Instead of sorting three vertices, we find the top and the bottom vertex, and the two chains of edges between them become the left and right sections. 
+    Sections with a height of zero (flat edges, or edges completely above the screen) are just skipped. 
+*/
+INLINE void drawPolygonFlatByggmastar(const RasterTriangle *poly) 
+{
+    const int numVerts = poly->numVerts;
+    int top = 0, bottom = 0;
+    int area = 0;
+    for (int i = 0; i < numVerts; ++i) {
+        const RasterPoint *v = poly->vert + i;
+        const RasterPoint *next = poly->vert + (i + 1 < numVerts ? i + 1 : 0);
+        area += v->x * next->y - next->x * v->y;
+        if (v->y < poly->vert[top].y) {
+            top = i;
+        }
+        if (v->y > poly->vert[bottom].y) {
+            bottom = i;
+        }
+    }
+    if (area == 0 || poly->vert[top].y >= g_rasterHeight - 1) { // Degenerate or certainly invisible. 
+        return;
+    }
+    const int width = g_rasterWidth;
+    // The chains are stored from the bottom (index 0) to the top vertex, like the arrays of drawTriangleFlatByggmastar. 
+    // With a positive (signed) area, the vertices are in clockwise order on the screen, so walking forward from the top vertex means walking down the right side.
+    const RasterPoint **forward = area > 0 ? right_array : left_array;
+    const RasterPoint **backward = area > 0 ? left_array : right_array;
+    int forwardLen = 0, backwardLen = 0;
+    for (int i = bottom; ; i = (i - 1 + numVerts) % numVerts) {
+        forward[forwardLen++] = poly->vert + i;
+        if (i == top) {
+            break;
+        }
+    }
+    for (int i = bottom; ; i = (i + 1) % numVerts) {
+        backward[backwardLen++] = poly->vert + i;
+        if (i == top) {
+            break;
+        }
+    }
+    left_section_idx = (area > 0 ? backwardLen : forwardLen) - 1;
+    right_section_idx = (area > 0 ? forwardLen : backwardLen) - 1;
+
+    while (calcLeftSection() <= 0) {
+        if (--left_section_idx <= 0) {
+            return;
+        }
+    }
+    while (calcRightSection() <= 0) {
+        if (--right_section_idx <= 0) {
+            return;
+        }
+    }
+    int y = MAX(0, poly->vert[top].y);
+    while (1) {
+        const int x1 = FIXED_16_2_INT_CEIL(left_x);
+        const int x2 = FIXED_16_2_INT_CEIL(right_x) - 1;
+        if (!(x1 < 0 &&  x2 < 0) && !(x1 >= width && x2 >= width) && x1 <= x2) { 
+            rasterSpan(MAX(0, x1), y, MIN(width - 1, x2), poly->color);
+        }
+        if (--left_section_height <= 0) { 
+            do {
+                if (--left_section_idx <= 0) {
+                    return;
+                }
+            } while (calcLeftSection() <= 0);
+        } else { 
+            left_x += delta_left_x;
+        }
+        if (--right_section_height <= 0) { 
+            do {
+                if (--right_section_idx <= 0) {
+                    return;
+                }
+            } while (calcRightSection() <= 0);
+        } else { 
+            right_x += delta_right_x;
+        }
+        ++y;
+    }
+}
+
+// The cross product of the edges (v1 - v0) and (v2 - v0) (in 64 bits: polygons which were clipped against the near plane can reach far beyond the screen).
+INLINE s64 rasterCross(const RasterPoint *v0, const RasterPoint *v1, const RasterPoint *v2) 
+{
+    return (s64)(v1->x - v0->x) * (v2->y - v0->y) - (s64)(v2->x - v0->x) * (v1->y - v0->y);
+}
+
+/* 
+    Returns invCross = 2^invShift / cross (for rasterPlaneGradients) with one 32-bit division. 
+    Big crosses are shifted down to 16 bits first (and invShift up accordingly), so invCross keeps at least 15 significant bits instead of rounding towards 0. 
+*/
+INLINE s32 rasterCrossReciprocal(s64 cross, int *invShift) 
+{
+    int shift = 0;
+    while ((cross >> shift) >= (1 << 15) || (cross >> shift) < -(1 << 15)) {
+        ++shift;
+    }
+    *invShift = 30 + shift;
+    return (1 << 30) / (s32)(cross >> shift);
+}
+
+/* 
+    Calculates the gradients d(attrib)/dx and d(attrib)/dy of the plane through the attributes a0, a1 and a2 at the given (screen) vertices,  
+    with invCross = 2^invShift / cross, where cross is the cross product of the edges (v1 - v0) and (v2 - v0) (cf. rasterCrossReciprocal). The gradients have fractShift more fractional bits than the attributes. 
+*/
+INLINE void rasterPlaneGradients(const RasterPoint *v0, const RasterPoint *v1, const RasterPoint *v2, s32 a0, s32 a1, s32 a2, s32 invCross, int invShift, int fractShift, s32 *dadx, s32 *dady) 
+{
+    const s64 da1 = a1 - a0, da2 = a2 - a0;
+    *dadx = (s32)(((da1 * (v2->y - v0->y) - da2 * (v1->y - v0->y)) * invCross) >> (invShift - fractShift));
+    *dady = (s32)(((da2 * (v1->x - v0->x) - da1 * (v2->x - v0->x)) * invCross) >> (invShift - fractShift));
+}
+
+/* 
+    Draws a textured triangle or convex polygon (cf. RasterAttributes) with the edge walkers above. 
+    The planes are determined by the first three vertices (for clipped polygons, all vertices lie in the same plane anyway, give or take rounding). 
+*/
+INLINE void drawPolygonTexturedByggmastar(const RasterTriangle *poly) 
+{
+    const RasterAttributes *tex = poly->attributes;
+    const RasterPoint *v0 = poly->vert, *v1 = poly->vert + 1, *v2 = poly->vert + 2;
+    const s64 cross = rasterCross(v0, v1, v2);
+    if (cross == 0) { 
+        return;
+    }
+    int invShift;
+    const s32 invCross = rasterCrossReciprocal(cross, &invShift);
+    rasterTex.texels = tex->texture->texels;
+    rasterTex.widthLog2 = tex->texture->widthLog2;
+    rasterTex.widthMask = (1 << tex->texture->widthLog2) - 1;
+    rasterTex.heightMask = (1 << tex->texture->heightLog2) - 1;
+    rasterTex.x0 = v0->x;
+    rasterTex.y0 = v0->y;
+    rasterTex.perspective = poly->shading == SHADING_TEXTURED_PERSPECTIVE;
+
+    // We move the texture coordinates as close to zero as we can (the texture wraps around anyway), so u/z and v/z don't overflow.
+    const FIXED uOffset = tex->texCoords[0].u & ~((int2fx(1) << tex->texture->widthLog2) - 1);
+    const FIXED vOffset = tex->texCoords[0].v & ~((int2fx(1) << tex->texture->heightLog2) - 1);
+    const FIXED u[3] = {tex->texCoords[0].u - uOffset, tex->texCoords[1].u - uOffset, tex->texCoords[2].u - uOffset};
+    const FIXED v[3] = {tex->texCoords[0].v - vOffset, tex->texCoords[1].v - vOffset, tex->texCoords[2].v - vOffset};
+
+    if (!rasterTex.perspective) {
+        rasterTex.u0 = u[0] << 8; // .8 to .16
+        rasterTex.v0 = v[0] << 8;
+        rasterPlaneGradients(v0, v1, v2, u[0], u[1], u[2], invCross, invShift, 8, &rasterTex.dudx, &rasterTex.dudy);
+        rasterPlaneGradients(v0, v1, v2, v[0], v[1], v[2], invCross, invShift, 8, &rasterTex.dvdx, &rasterTex.dvdy);
+    } else {
+        s32 uq[3], vq[3];
+        for (int i = 0; i < 3; ++i) {
+            uq[i] = (s32)(((s64)u[i] * tex->invZ[i]) >> FIX_SHIFT); // .8 times .16, so we shift to get .16 again.
+            vq[i] = (s32)(((s64)v[i] * tex->invZ[i]) >> FIX_SHIFT);
+        }
+        rasterTex.q0 = tex->invZ[0] << RASTER_PERSPECTIVE_GRADIENT_SHIFT;
+        rasterTex.uq0 = uq[0] << RASTER_PERSPECTIVE_GRADIENT_SHIFT;
+        rasterTex.vq0 = vq[0] << RASTER_PERSPECTIVE_GRADIENT_SHIFT;
+        rasterPlaneGradients(v0, v1, v2, tex->invZ[0], tex->invZ[1], tex->invZ[2], invCross, invShift, RASTER_PERSPECTIVE_GRADIENT_SHIFT, &rasterTex.dqdx, &rasterTex.dqdy);
+        rasterPlaneGradients(v0, v1, v2, uq[0], uq[1], uq[2], invCross, invShift, RASTER_PERSPECTIVE_GRADIENT_SHIFT, &rasterTex.duqdx, &rasterTex.duqdy);
+        rasterPlaneGradients(v0, v1, v2, vq[0], vq[1], vq[2], invCross, invShift, RASTER_PERSPECTIVE_GRADIENT_SHIFT, &rasterTex.dvqdx, &rasterTex.dvqdy);
+    }
+
+    if (poly->numVerts == 3) {
+        drawTriangleFlatByggmastar(poly);
+    } else {
+        drawPolygonFlatByggmastar(poly);
+    }
+    rasterTex.texels = NULL;
+}
+
+// Draws a Gouraud shaded triangle or convex polygon (cf. RasterAttributes) with the edge walkers above. 
+INLINE void drawPolygonGouraudByggmastar(const RasterTriangle *poly) 
+{
+    const RasterAttributes *attr = poly->attributes;
+    const RasterPoint *v0 = poly->vert, *v1 = poly->vert + 1, *v2 = poly->vert + 2;
+    const s64 cross = rasterCross(v0, v1, v2);
+    if (cross == 0) { 
+        return;
+    }
+    int invShift;
+    const s32 invCross = rasterCrossReciprocal(cross, &invShift);
+    rasterShade.ramp = attr->shadeRamp;
+    rasterShade.x0 = v0->x;
+    rasterShade.y0 = v0->y;
+    rasterShade.shade0 = (attr->shades[0] << 8) + (1 << 15); // .8 to .16 (and we round).
+    rasterPlaneGradients(v0, v1, v2, attr->shades[0], attr->shades[1], attr->shades[2], invCross, invShift, 8, &rasterShade.dsdx, &rasterShade.dsdy);
+    if (poly->numVerts == 3) {
+        drawTriangleFlatByggmastar(poly);
+    } else {
+        drawPolygonFlatByggmastar(poly);
+    }
+    rasterShade.ramp = NULL;
+}
+
 #endif
\ No newline at end of file
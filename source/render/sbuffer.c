@@ -0,0 +1,93 @@
+#include <tonc.h>
+
+#include "sbuffer.h"
+#include "../globals.h"
+
+/* 
+    The occupied spans of each scanline, sorted by x and disjoint (adjacent spans are merged). 
+    A fully occupied scanline consists of exactly one span from 0 to g_rasterWidth - 1. 
+*/
+typedef struct SBufferLine {
+    int numSpans;
+    SBufferSpan spans[SBUFFER_MAX_SPANS];
+} SBufferLine;
+
+IWRAM_DATA static SBufferLine sbuffer[M4_HEIGHT]; // Big enough for both mode 5 (scaled) and mode 4.
+static int fullLines; // The number of fully occupied scanlines.
+
+void sbufferClear(void) 
+{
+    for (int y = 0; y < g_rasterHeight; ++y) {
+        sbuffer[y].numSpans = 0;
+    }
+    fullLines = 0;
+}
+
+bool sbufferFull(void) 
+{
+    return fullLines == g_rasterHeight;
+}
+
+IWRAM_CODE_ARM int sbufferInsertSpan(int x1, int y, int x2, SBufferSpan visible[SBUFFER_MAX_SPANS + 1]) 
+{
+    SBufferLine *line = sbuffer + y;
+    SBufferSpan *spans = line->spans;
+    const int numSpans = line->numSpans;
+    int numVisible = 0;
+
+    // Skip the occupied spans which are completely to the left of the new span.
+    int first = 0;
+    while (first < numSpans && spans[first].end < x1) {
+        ++first;
+    }
+    // The gaps between the occupied spans which overlap the new span are visible.
+    int x = x1;
+    int last = first;
+    while (last < numSpans && spans[last].start <= x2) {
+        if (spans[last].start > x) {
+            visible[numVisible].start = x;
+            visible[numVisible++].end = spans[last].start - 1;
+        }
+        x = MAX(x, spans[last].end + 1);
+        ++last;
+    }
+    if (x <= x2) {
+        visible[numVisible].start = x;
+        visible[numVisible++].end = x2;
+    } else if (last - first == 1 && spans[first].start <= x1) { // The new span is completely hidden by one occupied span, so there's nothing to merge.
+        return 0;
+    }
+
+    // Replace the overlapped spans (first to last - 1) by one, and merge it with its direct neighbours if they're adjacent.
+    int start = first < last ? MIN(x1, spans[first].start) : x1;
+    int end = first < last ? MAX(x2, spans[last - 1].end) : x2;
+    if (first > 0 && spans[first - 1].end + 1 == start) {
+        start = spans[--first].start;
+    }
+    if (last < numSpans && spans[last].start == end + 1) {
+        end = spans[last++].end;
+    }
+    const int removed = last - first;
+    if (removed == 0 && numSpans == SBUFFER_MAX_SPANS) { // We ran out of spans.
+        return numVisible;
+    }
+    if (removed != 1) { // Move the spans to the right of the replaced ones.
+        const int shift = 1 - removed;
+        if (shift > 0) {
+            for (int i = numSpans - 1; i >= last; --i) {
+                spans[i + shift] = spans[i];
+            }
+        } else {
+            for (int i = last; i < numSpans; ++i) {
+                spans[i + shift] = spans[i];
+            }
+        }
+        line->numSpans = numSpans + shift;
+    }
+    spans[first].start = start;
+    spans[first].end = end;
+    if (line->numSpans == 1 && start == 0 && end == g_rasterWidth - 1) {
+        ++fullLines;
+    }
+    return numVisible;
+}
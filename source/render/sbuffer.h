@@ -0,0 +1,33 @@
+#ifndef SBUFFER_H
+#define SBUFFER_H
+
+#include <tonc.h>
+#include "../commondefs.h"
+
+/*
+    Span buffer ("s-buffer") for hidden surface removal: if we draw our polygons from front to back, we can keep track of 
+    which parts of each scanline are already occupied, and only draw the parts of new spans that are still free. 
+    That way, each pixel is written at most once per frame (as opposed to the painter's algorithm, which draws every covered pixel once per overlapping polygon).
+    cf. Paul Nettle's "S-Buffer FAQ" (1996)
+*/
+
+#define SBUFFER_MAX_SPANS 16 // The maximum number of disjoint occupied spans per scanline.
+
+/* Clears the span buffer; to be called before drawing a frame. */
+void sbufferClear(void);
+
+typedef struct SBufferSpan {
+    u8 start, end; // Inclusive (M4_WIDTH still fits into a u8).
+} SBufferSpan;
+
+/* 
+    Marks the span from x1 to x2 (inclusive, x1 <= x2, both within the screen) on scanline y as occupied. 
+    Writes the parts of it which were not occupied before (i.e. the parts which are visible and have to be drawn) into visible, and returns their number. 
+    If a scanline runs out of spans (which should be rare), the visible parts are returned anyway, but not marked as occupied. 
+*/
+int sbufferInsertSpan(int x1, int y, int x2, SBufferSpan visible[SBUFFER_MAX_SPANS + 1]);
+
+/* Returns true if every pixel of the screen is occupied (so we can stop drawing). */
+bool sbufferFull(void);
+
+#endif
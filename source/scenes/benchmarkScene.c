@@ -9,6 +9,7 @@
 #include "../render/draw.h"
 
 #include "../../data-models/suzanneModel.h"
+#include "../../data-models/suzanneLowModel.h"
 
 static Timer timer;
 static Camera cam;
@@ -16,6 +17,7 @@ static Vec3 lightDirection;
 
 #define MAX_MONKEY_NUM 2
 ModelInstance monkeyPoolBuffer[2];
+u16 monkeyPoolLive[2];
 ModelInstancePool monkeyPool;
 ModelInstance *monkey, *cube;
 
@@ -34,12 +36,14 @@ void benchmarkSceneInit(void)
 { 
     timer = timerNew(TIMER_MAX_DURATION, TIMER_REGULAR);
     suzanneModelInit();
+    suzanneLowModelInit();
     cam = cameraNew((Vec3){.x=0, .y=0, .z=0}, CAMERA_VERTICAL_FOV_43_DEG, int2fx(1), int2fx(64), g_mode);
-    monkeyPool = modelInstancePoolNew(monkeyPoolBuffer, MAX_MONKEY_NUM);
+    monkeyPool = modelInstancePoolNew(monkeyPoolBuffer, monkeyPoolLive, MAX_MONKEY_NUM);
     lightDirection = (Vec3){.x = 0, .y = 0, .z=int2fx(-3)};
     lightDirection = vecUnit(lightDirection);
 
-    monkey = modelInstanceAddVanilla(&monkeyPool, suzanneModel, &(Vec3){.x=int2fx(0), .y=0, .z=int2fx(-4)}, int2fx(1), SHADING_FLAT_LIGHTING);
+    // The low-poly suzanne (124 instead of 207 faces) with Gouraud shading; KEY_R switches to the original one with flat shading for comparison.
+    monkey = modelInstanceAddVanilla(&monkeyPool, suzanneLowModel, &(Vec3){.x=int2fx(0), .y=0, .z=int2fx(-4)}, int2fx(1), SHADING_GOURAUD);
     cube = modelInstanceAddVanilla(&monkeyPool, cubeModel, &(Vec3){.x=float2fx(-1.6), .y=0, .z=int2fx(-3)}, int2fx(2), SHADING_FLAT_LIGHTING);
     cube->state.yaw = deg2fxangle(-45);
     cube->state.pitch = deg2fxangle(-45);
@@ -58,13 +62,34 @@ void benchmarkSceneUpdate(void)
 static bool lightToggle;
 IWRAM_CODE_ARM void benchmarkSceneDraw(void) 
 {
+    if (key_hit(KEY_L)) { // Compare mode 5 (scaled, 160x100) with mode 4 (240x160).
+        const int mode = cam.mode == DCNT_MODE4 ? DCNT_MODE5 : DCNT_MODE4;
+        cam = cameraNew(cam.pos, CAMERA_VERTICAL_FOV_43_DEG, int2fx(1), int2fx(64), mode);
+        if (mode == DCNT_MODE4) {
+            videoM4Init();
+        } else {
+            videoM5ScaledInit();
+        }
+    }
     drawBefore(&cam);
-    m5ScaledFill(CLR_BLACK);
+    if (cam.mode == DCNT_MODE4) {
+        m4_fill(0);
+    } else {
+        m5ScaledFill(CLR_BLACK);
+    }
     ModelDrawLightingData lightDataDir = {.type=LIGHT_DIRECTIONAL, .light.directional=&lightDirection, .attenuation=&lightAttenuation160};
     ModelDrawLightingData lightDataPoint = {.type=LIGHT_POINT, .light.directional=&cam.pos, .attenuation=&lightAttenuation160};
     if (key_hit(KEY_A)) {
         lightToggle = !lightToggle;
     }
+    if (key_hit(KEY_R)) {
+        const bool gouraud = monkey->state.shading == SHADING_GOURAUD;
+        monkey->state.mod = gouraud ? suzanneModel : suzanneLowModel;
+        monkey->state.shading = gouraud ? SHADING_FLAT_LIGHTING : SHADING_GOURAUD;
+    }
+    if (key_hit(KEY_B)) { // Compare the painter's algorithm with the span buffer (cf. "draw.c: rasterisation").
+        drawSetHiddenSurfaceRemoval(drawGetHiddenSurfaceRemoval() == DRAW_HSR_SBUFFER ? DRAW_HSR_ORDERING_TABLE : DRAW_HSR_SBUFFER);
+    }
     if (!lightToggle) {
         drawModelInstancePools(&monkeyPool, 1, &cam, lightDataDir);
     } else {
@@ -75,7 +100,11 @@ IWRAM_CODE_ARM void benchmarkSceneDraw(void)
 void benchmarkSceneStart(void) 
 {
     timerStart(&timer);
-    videoM5ScaledInit();
+    if (cam.mode == DCNT_MODE4) {
+        videoM4Init();
+    } else {
+        videoM5ScaledInit();
+    }
 }
 
 void benchmarkScenePause(void) 
@@ -86,5 +115,9 @@ void benchmarkScenePause(void)
 void benchmarkSceneResume(void) 
 {
     timerResume(&timer);
-    videoM5ScaledInit();
+    if (cam.mode == DCNT_MODE4) {
+        videoM4Init();
+    } else {
+        videoM5ScaledInit();
+    }
 }
@@ -11,18 +11,25 @@
 #include "../logutils.h"
 #include "../timer.h"
 #include "../math.h"
+#include "../particles.h"
 
 #define NUM_CUBES 9
-#define NUM_POINTS 200
+#define NUM_STARS 200
+#define MAX_SPARKS 1024
 
 EWRAM_DATA static ModelInstance __cubesBuffer[NUM_CUBES];
+EWRAM_DATA static u16 __cubesLive[NUM_CUBES];
 static ModelInstancePool cubePool;
 
 static Camera camera;
 static Vec3 lightDirection;
 static Timer timer;
 
-EWRAM_DATA static Vec3 points[NUM_POINTS];
+EWRAM_DATA static u32 starBuffer[PARTICLE_POOL_BUFFER_WORDS(NUM_STARS)];
+EWRAM_DATA static u32 sparkBuffer[PARTICLE_POOL_BUFFER_WORDS(MAX_SPARKS)];
+static ParticlePool stars, sparks;
+static ParticleEmitter sparkEmitter; // A fountain of sparks from the cube in the middle.
+static Vec3 gravity;
 
 static int perfDrawID, perfProjectID, perfSortID;
 
@@ -35,22 +42,26 @@ void cubespaceSceneInit(void) {
         perfSortID = performanceDataRegister("Polygon depth sort");
         lightDirection = (Vec3){.x=int2fx(5), .y=int2fx(-8), .z=int2fx(2)};
         lightDirection = vecUnit(lightDirection);
+        gravity = (Vec3){.x=0, .y=int2fx(-10), .z=0};
         
-        cubePool = modelInstancePoolNew(__cubesBuffer, sizeof __cubesBuffer / sizeof __cubesBuffer[0]);
+        cubePool = modelInstancePoolNew(__cubesBuffer, __cubesLive, sizeof __cubesBuffer / sizeof __cubesBuffer[0]);
         int size = 12;
         for (int i = 0; i < NUM_CUBES; ++i) {
                 modelInstanceAddVanilla(&cubePool, cubeModel, &(Vec3){.x=int2fx(size * (i % 3)), .y=int2fx(0), .z=int2fx(size * (i / 3))}, int2fx(size), SHADING_FLAT_LIGHTING );
         }
 
-        for (int i = 0; i < NUM_POINTS; ++i) {  // Initialise stars.
+        stars = particlePoolNew(starBuffer, NUM_STARS);
+        for (int i = 0; i < NUM_STARS; ++i) {  // Initialise stars.
                 int dirx = qran() % 2 ? 1 : -1;
                 int diry = qran() % 2 ? 1 : -1;
                 int dirz = qran() % 2 ? 1 : -1;
                 FIXED x = int2fx( qran_range(9, 81));
                 FIXED y = int2fx( qran_range(9, 81));
                 FIXED z = int2fx( qran_range(9, 81));
-                points[i] = (Vec3){(x * dirx), (y * diry), (dirz*z)};
+                particleAdd(&stars, (Vec3){(x * dirx), (y * diry), (dirz*z)}, (Vec3){0, 0, 0}, PARTICLE_LIFE_INFINITE, CLR_WHITE);
         }
+        sparks = particlePoolNew(sparkBuffer, MAX_SPARKS);
+        sparkEmitter = particleEmitterNew(cubePool.instances[4].state.pos, (Vec3){.x=0, .y=int2fx(14), .z=0}, (Vec3){.x=int2fx(6), .y=int2fx(4), .z=int2fx(6)}, int2fx12(2), int2fx12(1) >> 1, 480, RGB15(31, 24, 8));
 }
 
 void cubespaceSceneUpdate(void) 
@@ -73,6 +84,9 @@ void cubespaceSceneUpdate(void)
         camera.roll += timer.deltatime * 2;
         camera.pitch = deg2fxangle(4);
         camera.yaw = deg2fxangle(2);
+        sparkEmitter.pos = cubePool.instances[4].state.pos;
+        particleEmitterUpdate(&sparkEmitter, &sparks, timer.deltatime);
+        particlesUpdate(&sparks, gravity, timer.deltatime);
         timerTick(&timer);
 
         if (timer.time > int2fx12(5)) {
@@ -84,7 +98,8 @@ void cubespaceSceneDraw(void)
 {
         drawBefore(&camera);
         memset32(vid_page, dup16(CLR_BLACK), (M5_SCALED_H  * M5_SCALED_W)/2);	
-        drawPoints(&camera, points, NUM_POINTS, CLR_WHITE);
+        drawParticles(&camera, &stars, 0);
+        drawParticles(&camera, &sparks, int2fx(1) >> 1); // (Before the cubes, as the particles aren't depth tested.)
         drawModelInstancePools(&cubePool, 1, &camera, (ModelDrawLightingData){.type=LIGHT_DIRECTIONAL, .light.directional=&lightDirection, .attenuation=NULL});
 }
 
@@ -13,6 +13,7 @@ static Timer timer;
 
 #define NUM_GBA 1
 EWRAM_DATA static ModelInstance __gbaBuffer[NUM_GBA];
+EWRAM_DATA static u16 __gbaLive[NUM_GBA];
 static ModelInstancePool gbaPool;
 static ModelInstance *gbaModelInstance;
 
@@ -28,7 +29,7 @@ void gbaSceneInit(void)
     camera = cameraNew((Vec3){.x=int2fx(0), .y=int2fx(0), .z=int2fx(120)}, CAMERA_VERTICAL_FOV_43_DEG, int2fx(1), int2fx(256), g_mode);
     lightDirection = (Vec3){.x=int2fx(3), .y=int2fx(-4), .z=int2fx(-3)};
     lightDirection = vecUnit(lightDirection);
-    gbaPool = modelInstancePoolNew(__gbaBuffer, sizeof __gbaBuffer / sizeof __gbaBuffer[0]);
+    gbaPool = modelInstancePoolNew(__gbaBuffer, __gbaLive, sizeof __gbaBuffer / sizeof __gbaBuffer[0]);
     gbaModelInstance = modelInstanceAddVanilla(&gbaPool, gbaModel, &(Vec3){.x=0, .y=0, .z=0}, int2fx(10), SHADING_FLAT);
 }
 
@@ -15,6 +15,7 @@ static Timer timer;
 #include "../../data-models/cpaModel.h"
 
 EWRAM_DATA static ModelInstance __modelBuffer[1];
+EWRAM_DATA static u16 __modelLive[1];
 static ModelInstancePool modelPool;
 static ModelInstance *moleculeInstance;
 
@@ -29,7 +30,7 @@ void moleculeSceneInit(void)
     timer = timerNew(TIMER_MAX_DURATION, TIMER_REGULAR);
     camera = cameraNew((Vec3){.x=int2fx(0), .y=int2fx(0), .z=int2fx(0)}, CAMERA_VERTICAL_FOV_43_DEG, int2fx(1), int2fx(FAR), g_mode);
 
-    modelPool = modelInstancePoolNew(__modelBuffer, sizeof __modelBuffer / sizeof __modelBuffer[0]);
+    modelPool = modelInstancePoolNew(__modelBuffer, __modelLive, sizeof __modelBuffer / sizeof __modelBuffer[0]);
 
     moleculeInstance = modelInstanceAddVanilla(&modelPool, cpaModel, &(Vec3){.x=0, .y=0, .z=0}, int2fx(1), SHADING_WIREFRAME);
     moleculeInstance->state.backfaceCulling = false;
@@ -10,6 +10,8 @@
 
 #include "../../data-models/subwayModel.h"
 #include "../../data-models/treeModel.h"
+#include "../../data-campaths/subwayOutsidePath.h"
+#include "../../data-campaths/subwayInsidePath.h"
 
 
 static Timer timer;
@@ -18,6 +20,7 @@ static Timer timer;
 #define NUM_TREES 20
 #define MAX_MODELS (NUM_TREES + 1)
 EWRAM_DATA static ModelInstance __modelBuffer[MAX_MODELS];
+EWRAM_DATA static u16 __modelLive[MAX_MODELS];
 EWRAM_DATA static ModelInstance* trees[NUM_TREES];
 
 static ModelInstancePool modelPool;
@@ -37,14 +40,14 @@ void subwaySceneInit(void)
     camera = cameraNew((Vec3){.x=int2fx(0), .y=int2fx(6), .z=int2fx(42)}, CAMERA_VERTICAL_FOV_43_DEG, int2fx(1), int2fx(FAR), g_mode);
     lightDirection = (Vec3){.x=int2fx(3), .y=int2fx(-4), .z=int2fx(-3)};
     lightDirection = vecUnit(lightDirection);
-    modelPool = modelInstancePoolNew(__modelBuffer, sizeof __modelBuffer / sizeof __modelBuffer[0]);
+    modelPool = modelInstancePoolNew(__modelBuffer, __modelLive, sizeof __modelBuffer / sizeof __modelBuffer[0]);
 
     subwayInstance = modelInstanceAddVanilla(&modelPool, subwayModel, &(Vec3){.x=0, .y=0, .z=0}, int2fx(2), SHADING_FLAT);
     subwayInstance->state.backfaceCulling = false;
 
     const int treeSpacing = 34; // Z-spacing.
     const int leftZOffset = 16; 
-    for (int i = 0; i < NUM_TREES / 2; i+=2) {
+    for (int i = 0; i < NUM_TREES; i+=2) {
         trees[i] = modelInstanceAddVanilla(&modelPool, treeModel, &(Vec3){.x=int2fx(28), .y=0, .z= i * int2fx(treeSpacing)}, int2fx(1) + 200, SHADING_FLAT); // Right.
         trees[i+1] = modelInstanceAddVanilla(&modelPool, treeModel, &(Vec3){.x=int2fx(-28), .y=0, .z= i * int2fx(treeSpacing - 4) + int2fx(leftZOffset)}, int2fx(1) + 200, SHADING_FLAT); // Left
         trees[i]->state.yaw = deg2fxangle(-56);
@@ -55,22 +58,16 @@ void subwaySceneInit(void)
 void subwaySceneUpdate(void) 
 {
     timerTick(&timer);
-    const FIXED_12 camMoveDuration = int2fx12(10);
-    const FIXED camMoveDurationZ = int2fx12(15);
+    const FIXED_12 camMoveDurationZ = int2fx12(15);
     const FIXED_12 startTimeOffset = 1000;  
-    FIXED_12 t =  (fx12div(timer.time + startTimeOffset , camMoveDuration));
-    FIXED_12 tZ =  (fx12div(timer.time + startTimeOffset, camMoveDurationZ ));
 
-    if (tZ < int2fx12(1)) { // Camera outside. 
-        camera.pos.z = lerpSmooth(int2fx(-35), int2fx(76), tZ);
-        camera.pos.x =  lerpSmooth(int2fx(48), int2fx(16), t);
-        camera.pos.y =  lerpSmooth(int2fx(0), int2fx(10), tZ);
+    if (timer.time + startTimeOffset < camMoveDurationZ) { // Camera outside (cf. assets/campaths/subwayOutside.campath).
+        cameraPathApply(&camera, &subwayOutsidePath, timer.time + startTimeOffset);
     } else { // Camera inside
-        FIXED_12 tInside = (fx12div(timer.time - camMoveDurationZ, int2fx12(8))); 
-        camera.lookAt = (Vec3){.x = int2fx(-10), .y=int2fx(1), .z= lerpSmooth(int2fx(-2), int2fx(-16), tInside)};
-        camera.pos = (Vec3){.x = 240, .y = int2fx(2), .z = int2fx(-5)};
+        const FIXED_12 timeInside = timer.time - camMoveDurationZ;
+        cameraPathApply(&camera, &subwayInsidePath, timeInside);
 
-        if (tInside > int2fx12(1)) {
+        if (timeInside > int2fx12(8)) {
             sceneSwitchTo(GBASCENE);
         }
 
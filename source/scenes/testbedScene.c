@@ -13,6 +13,8 @@
 #include "../timer.h"
 
 #include "../../data-models/headModel.h"
+#include "../../data-models/crateModel.h"
+#include "../../data-models/flagModel.h"
 
 
 #define NUM_CUBES 9
@@ -21,11 +23,22 @@
 #define RELEASE
 
 EWRAM_DATA static ModelInstance __cubeBuffer[NUM_CUBES];
+EWRAM_DATA static u16 __cubeLive[NUM_CUBES];
 static ModelInstancePool cubePool;
 
 EWRAM_DATA static ModelInstance __headBuffer[3];
+EWRAM_DATA static u16 __headLive[3];
 static ModelInstancePool headPool;
 
+EWRAM_DATA static ModelInstance __crateBuffer[2];
+EWRAM_DATA static u16 __crateLive[2];
+static ModelInstancePool cratePool;
+
+EWRAM_DATA static ModelInstance __flagBuffer[1];
+EWRAM_DATA static u16 __flagLive[1];
+static ModelInstancePool flagPool;
+static ModelInstance *flag;
+
 static Camera camera;
 static Vec3 lightDirection;
 static Timer timer;
@@ -41,16 +54,19 @@ static int perfDrawID, perfProjectID, perfSortID;
 void testbedSceneInit(void) 
 {     
         headModelInit(); 
+        crateModelInit();
+        flagModelInit();
         camera = cameraNew((Vec3){.x=int2fx(0), .y=int2fx(0), .z=int2fx(20)}, CAMERA_VERTICAL_FOV_43_DEG, int2fx(1), int2fx(128), g_mode);
         timer = timerNew(TIMER_MAX_DURATION, TIMER_REGULAR);
         perfDrawID = performanceDataRegister("Drawing");
         perfProjectID = performanceDataRegister("3d-math");
         perfSortID = performanceDataRegister("Polygon depth sort");
-        lightDirection = (Vec3){.x=int2fx(3), .y=int2fx(-4), .z=int2fx(-3)};
-        lightDirection = vecUnit(lightDirection);
+        lightDirection = flagPrelitLight; // The flag's lighting is baked (cf. prelit-light in assets/models/config), so everything else gets the same light.
         
-        cubePool = modelInstancePoolNew(__cubeBuffer, sizeof __cubeBuffer / sizeof __cubeBuffer[0]);
-        headPool = modelInstancePoolNew(__headBuffer, sizeof __headBuffer / sizeof __headBuffer[0]);
+        cubePool = modelInstancePoolNew(__cubeBuffer, __cubeLive, sizeof __cubeBuffer / sizeof __cubeBuffer[0]);
+        headPool = modelInstancePoolNew(__headBuffer, __headLive, sizeof __headBuffer / sizeof __headBuffer[0]);
+        cratePool = modelInstancePoolNew(__crateBuffer, __crateLive, sizeof __crateBuffer / sizeof __crateBuffer[0]);
+        flagPool = modelInstancePoolNew(__flagBuffer, __flagLive, sizeof __flagBuffer / sizeof __flagBuffer[0]);
         
         // Grid of cubes:
         FIXED size = int2fx(4);
@@ -74,6 +90,16 @@ void testbedSceneInit(void)
         Vec3 headScale = {.x=int2fx(2),.y=int2fx(2), .z=int2fx(2)};
         weirdHead = modelInstanceAdd(&headPool, headModel, &cubesCenter, &headScale, 0, deg2fxangle(-62), 0, SHADING_FLAT_LIGHTING);
         weirdHead2 = modelInstanceAdd(&headPool, headModel, &cubesCenter, &headScale, 0, deg2fxangle(62), deg2fxangle(180), SHADING_FLAT_LIGHTING);
+
+        // Two textured crates in front of the grid (the near one with perspective correction, as it gets large on screen).
+        Vec3 crateScale = {.x=int2fx(2), .y=int2fx(2), .z=int2fx(2)};
+        modelInstanceAdd(&cratePool, crateModel, &(Vec3){.x=x_start - size, .y=int2fx(4), .z=size + padding}, &crateScale, 0, deg2fxangle(30), 0, SHADING_TEXTURED_PERSPECTIVE);
+        modelInstanceAdd(&cratePool, crateModel, &(Vec3){.x=-x_start + size, .y=int2fx(4), .z=size + padding}, &crateScale, 0, deg2fxangle(-15), 0, SHADING_TEXTURED);
+
+        // A waving flag (vertex animation, cf. ModelMorph) above the grid; it's just a sheet, so no backface culling. 
+        // It doesn't rotate, so it's prelit (the morph keys share the normals of the first key anyway), and ignores the point light of the release build.
+        flag = modelInstanceAddVanilla(&flagPool, flagModel, &(Vec3){.x=x_start, .y=int2fx(6), .z=z}, int2fx(2), SHADING_PRELIT);
+        flag->state.backfaceCulling = false;
 }        
 
 
@@ -89,7 +115,11 @@ void testbedSceneUpdate(void)
                 // cubePool.instances[i].state.scale = int2fx(8) +  fxmul(sinFx( fx12mul(timer.time, deg2fxangle(360)  )), int2fx(2));
         }
         weirdHead->state.yaw -= fx12mul(int2fx12(1), fx12mul(timer.deltatime, deg2fxangle(80)) );
+        for (int i = 0; i < cratePool.instanceCount; ++i) {
+                cratePool.instances[i].state.yaw += fx12mul(timer.deltatime, deg2fxangle(45));
+        }
         weirdHead2->state.yaw += fx12mul(int2fx12(1), fx12mul(timer.deltatime, deg2fxangle(80)) );
+        modelInstanceMorphSet(flag, fx12Tofx(timer.time * 3)); // Three keys per second.
 
         weirdHead->state.pos.y = fxmul(sinFx(fx12mul(timer.time, deg2fxangle(320))), int2fx(1)) - int2fx(4);
         weirdHead2->state.pos.y = fxmul(cosFx(fx12mul(timer.time, deg2fxangle(320))), int2fx(1)) + int2fx(4);
@@ -140,17 +170,17 @@ void testbedSceneDraw(void)
         ModelDrawLightingData lightDataPoint = {.type=LIGHT_POINT, .light.point=&camera.pos, .attenuation=&lightAttenuation160};
         ModelDrawLightingData lightDataDir = {.type=LIGHT_DIRECTIONAL, .light.directional=&lightDirection, .attenuation=NULL};
 
-        ModelInstancePool pools[2] = {headPool, cubePool};
+        ModelInstancePool pools[4] = {headPool, cubePool, cratePool, flagPool};
         #ifndef RELEASE
         if (key_hit(KEY_SELECT)) {
                 toggle = !toggle;
         }
         if (!toggle)
-                drawModelInstancePools(pools, 2, &camera, lightDataDir);
+                drawModelInstancePools(pools, 4, &camera, lightDataDir);
         else
-                drawModelInstancePools(pools, 2, &camera, lightDataPoint);
+                drawModelInstancePools(pools, 4, &camera, lightDataPoint);
         #else
-                drawModelInstancePools(pools, 2, &camera, lightDataPoint);
+                drawModelInstancePools(pools, 4, &camera, lightDataPoint);
         #endif
 }
 
@@ -43,6 +43,9 @@ typedef struct PerformanceData {
     Timer timer;
     FIXED_12 avgTime;
     int avgSamples;
+#ifdef HOST_BUILD // The host build measures wall-clock nanoseconds instead (cf. timer.c).
+    u64 hostStartNs, hostTimeNs, hostAvgTimeNs;
+#endif
 } PerformanceData;
 
 int performanceDataRegister(const char* name);// invariant: has to be called once per second TODO: allow for TIMER_REGULAR
@@ -0,0 +1,128 @@
+"""
+Converts the camera paths in assets/campaths (*.campath) into C (cf. CameraPath in source/camera.h).
+A .campath file has one key per line: the time (in seconds, increasing), the position (x y z), and the lookAt point (x y z), all separated by whitespace.
+With a line "bake: <rate>", the world2cam matrices along the path are computed here (in floating point), rate times per second, so the GBA only has to interpolate them.
+Lines starting with # are comments.
+"""
+import math
+import pathlib
+import textwrap
+
+def float2fx8(n):
+    return round(n * 256)
+
+def float2fx12(n):
+    return round(n * 4096)
+
+
+class CameraPath:
+    class ParseError(Exception):
+        pass
+
+    def __init__(self, filename: pathlib.Path):
+        self.name = filename.stem + "Path"
+        self.input_filename = filename
+        self.keys = [] # (time, pos, lookAt)
+        self.bake_rate = None
+        for line_num, line in enumerate(open(filename)):
+            line = line.split("#")[0].strip()
+            if not line:
+                continue
+            if line.startswith("bake:"):
+                self.bake_rate = int(line.partition(":")[2])
+                continue
+            values = [float(v) for v in line.split()]
+            if len(values) != 7:
+                raise CameraPath.ParseError(f"{filename} line {line_num + 1}: Expected 7 numbers (time, position, lookAt), got {len(values)}.")
+            if self.keys and values[0] <= self.keys[-1][0]:
+                raise CameraPath.ParseError(f"{filename} line {line_num + 1}: The times of the keys must increase.")
+            self.keys.append((values[0], values[1:4], values[4:7]))
+        if len(self.keys) < 2:
+            raise CameraPath.ParseError(f"{filename}: A path needs at least two keys.")
+
+    def sample(self, time):
+        """ The position and lookAt point at the given time, like cameraPathSample in source/camera.c (a uniform Catmull-Rom spline). """
+        keys, last = self.keys, len(self.keys) - 1
+        time = max(keys[0][0], min(time, keys[last][0]))
+        i = 0
+        while i < last - 1 and time >= keys[i + 1][0]:
+            i += 1
+        t = (time - keys[i][0]) / (keys[i + 1][0] - keys[i][0])
+        k0, k1, k2, k3 = keys[max(i - 1, 0)], keys[i], keys[i + 1], keys[min(i + 2, last)]
+        def catmull_rom(p0, p1, p2, p3):
+            return 0.5 * (2 * p1 + (-p0 + p2) * t + (2 * p0 - 5 * p1 + 4 * p2 - p3) * t**2 + (-p0 + 3 * p1 - 3 * p2 + p3) * t**3)
+        pos = [catmull_rom(k0[1][c], k1[1][c], k2[1][c], k3[1][c]) for c in range(3)]
+        look_at = [catmull_rom(k0[2][c], k1[2][c], k2[2][c], k3[2][c]) for c in range(3)]
+        return pos, look_at
+
+    def world2cam(self, time):
+        """ The upper three rows of world2cam at the given time, like cameraComputeWorldToCamSpace in source/camera.c (without yaw, pitch and roll). """
+        pos, look_at = self.sample(time)
+        def unit(v):
+            length = math.sqrt(sum(c * c for c in v))
+            if length == 0:
+                raise CameraPath.ParseError(f"{self.input_filename}: The camera position and the lookAt point coincide at {time:.2f} s.")
+            return [c / length for c in v]
+        def cross(a, b):
+            return [a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]]
+        forward = unit([pos[c] - look_at[c] for c in range(3)])
+        right = unit(cross([0, 1, 0], forward))
+        up = unit(cross(forward, right))
+        rows = []
+        for axis in (right, up, forward):
+            rows += axis + [-sum(axis[c] * pos[c] for c in range(3))]
+        return rows
+
+    def generate_code(self):
+        header_file = textwrap.dedent(f"""
+        #ifndef {self.name}_H
+        #define {self.name}_H
+        #include "../source/camera.h"
+
+        extern const CameraPath {self.name};
+
+        #endif
+        """)
+        keys_string = f"static const CameraKey {self.name}Keys[{len(self.keys)}] = {{"
+        for time, pos, look_at in self.keys:
+            keys_string += f"{{.time={float2fx12(time)}, .pos={{{', '.join(str(float2fx8(c)) for c in pos)}}}, .lookAt={{{', '.join(str(float2fx8(c)) for c in look_at)}}}}}, "
+        keys_string += "};"
+        baked_string, baked_init = "", ".bakedWorld2cam=NULL, .numBaked=0, .bakeRate=0"
+        if self.bake_rate:
+            start, end = self.keys[0][0], self.keys[-1][0]
+            num_baked = math.ceil((end - start) * self.bake_rate) + 1
+            baked_string = f"static const FIXED {self.name}World2cam[{num_baked}][12] = {{"
+            for i in range(num_baked):
+                baked_string += f"{{{', '.join(str(float2fx8(v)) for v in self.world2cam(start + i / self.bake_rate))}}}, "
+            baked_string += "};"
+            baked_init = f".bakedWorld2cam={self.name}World2cam, .numBaked={num_baked}, .bakeRate={self.bake_rate}"
+        data_file = textwrap.dedent(f"""
+        #include "{self.name}.h"
+
+        {keys_string}
+
+        {baked_string}
+
+        const CameraPath {self.name} = {{.keys={self.name}Keys, .numKeys={len(self.keys)}, {baked_init}}};
+        """)
+        return {self.name + ".h": header_file, self.name + ".c": data_file}
+
+
+# With respect to the project directory.
+CAMPATH_DIR = "assets/campaths/"
+OUT_DIR_DATA = "data-campaths/"
+
+if __name__ == "__main__":
+    paths = [CameraPath(filepath) for filepath in sorted(pathlib.Path(".").joinpath(CAMPATH_DIR).glob("*.campath"))]
+    outfile_paths = []
+    for path in paths:
+        for file_basename, file_content in path.generate_code().items():
+            out = pathlib.Path(".").joinpath(OUT_DIR_DATA).joinpath(file_basename)
+            with open(out, "w") as f:
+                f.write(file_content)
+            outfile_paths.append(str(out))
+    if not paths:
+        print("Nothing to be done.")
+    else:
+        print(f"In:\t{' '.join(str(path.input_filename) for path in paths)}\nOut:\t{' '.join(outfile_paths)}")
+        print("Converted all camera paths \033[92m(Success)\033[0m")
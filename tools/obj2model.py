@@ -1,7 +1,11 @@
+import copy
+import heapq
 import math
 import pathlib
 import re
+import struct
 import textwrap
+import zlib
 from typing import Dict
 
 MAX_FX8 = 2**23 - 1 # Largest number representable as 24.8 fixed point. We will never run into it with non-ridiculous data. 
@@ -9,6 +13,69 @@ MAX_FX8 = 2**23 - 1 # Largest number representable as 24.8 fixed point. We will
 def float2fx8(n): 
     return int(n * 256)
 
+def png_read(filename: pathlib.Path):
+    """ 
+    Minimal PNG decoder (8-bit, non-interlaced greyscale/RGB/palette images with or without alpha), so we don't need any dependencies for textures. 
+    Returns (width, height, pixels) with pixels as a list of (r, g, b) tuples in row-major order. 
+    cf. https://www.w3.org/TR/png/ (last retrieved 2021-08-04)
+    """
+    data = open(filename, "rb").read()
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        raise ValueError(f"'{filename}' is not a PNG file.")
+    pos = 8
+    idat = b""
+    palette = []
+    width = height = color_type = 0
+    while pos < len(data):
+        length, chunk_type = struct.unpack(">I4s", data[pos:pos + 8])
+        chunk = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if chunk_type == b"IHDR":
+            width, height, bit_depth, color_type, _, _, interlace = struct.unpack(">IIBBBBB", chunk)
+            if bit_depth != 8 or interlace != 0 or color_type not in (0, 2, 3, 4, 6):
+                raise ValueError(f"'{filename}': Only 8-bit non-interlaced PNGs are supported.")
+        elif chunk_type == b"PLTE":
+            palette = [tuple(chunk[i:i + 3]) for i in range(0, len(chunk), 3)]
+        elif chunk_type == b"IDAT":
+            idat += chunk
+        elif chunk_type == b"IEND":
+            break
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[color_type]
+    raw = zlib.decompress(idat)
+    stride = width * channels
+    rows = []
+    prev = bytearray(stride)
+    for y in range(height):
+        filter_type = raw[y * (stride + 1)]
+        row = bytearray(raw[y * (stride + 1) + 1:(y + 1) * (stride + 1)])
+        for x in range(stride):
+            a = row[x - channels] if x >= channels else 0
+            b = prev[x]
+            c = prev[x - channels] if x >= channels else 0
+            if filter_type == 1:
+                row[x] = (row[x] + a) & 0xff
+            elif filter_type == 2:
+                row[x] = (row[x] + b) & 0xff
+            elif filter_type == 3:
+                row[x] = (row[x] + (a + b) // 2) & 0xff
+            elif filter_type == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                row[x] = (row[x] + (a if pa <= pb and pa <= pc else b if pb <= pc else c)) & 0xff
+        rows.append(row)
+        prev = row
+    pixels = []
+    for row in rows:
+        for x in range(width):
+            px = row[x * channels:(x + 1) * channels]
+            if color_type == 3:
+                pixels.append(palette[px[0]])
+            elif color_type in (0, 4):
+                pixels.append((px[0], px[0], px[0]))
+            else:
+                pixels.append(tuple(px[:3]))
+    return width, height, pixels
+
 class Model:
     class ModelParseError(Exception):
         pass
@@ -16,20 +83,30 @@ class Model:
     class Face:
         def __init__(self):
             self.vert_idx = []
+            self.tex_coord_idx = []
             self.normal_idx: int
+            self.vert_normal_idx = [] # The normal of each of the face's vertices (they differ from the face normal for smooth shaded .obj files).
             self.color = (31, 31, 31)
         
-    def __init__(self, filename: pathlib.Path, max_model_verts=None, max_model_faces=None):
+    def __init__(self, filename: pathlib.Path, max_model_verts=None, max_model_faces=None, bsp=False, wireframe=False):
         self.name = re.sub(r"\W", "", filename.stem) # Remove non-word characters.
         if len(self.name) < 1:
             raise Model.ModelParseError(f"'{self.name}' is not a valid model name. It also should be a valid name for a C identifier (I don't validate that properly, but it *should*).")
         self.verts = []
         self.faces = []
         self.normals = []
+        self.normals_float = [] # Unquantised, for the vertex normals. 
+        self.tex_coords = []
         self.materials = {}
+        self.texture_file = None # The texture (map_Kd) of the materials (only one per model); it is used if the faces have texture coordinates.
         self.max_model_faces = max_model_faces
         self.max_model_verts = max_model_verts
         self.input_filename = filename
+        self.bsp = bsp # Whether to build a BSP tree (cf. bsp_build).
+        self.wireframe = wireframe # Whether to export the edges for SHADING_WIREFRAME (cf. unique_edges).
+        self.lower_detail = None # The Model of the next lower level of detail (cf. decimated).
+        self.morph_keys = [] # The vertices of each key of the vertex animation (the first key is self.verts), cf. morph_keys_read.
+        self.prelit_light = None # The direction of the light (in model space) to bake the colours of the faces with for SHADING_PRELIT, cf. prelit_colors.
         self.obj_parse(filename)
 
     def material_parse(self): 
@@ -37,6 +114,12 @@ class Model:
         if mtl_file.exists():
             current_mtl = ""
             for line in open(mtl_file):
+                if line.strip().lower().startswith("map_kd"): # (The filename is case-sensitive, so we look at it before lowering the line.)
+                    texture_file = mtl_file.parent.joinpath(line.strip().split(maxsplit=1)[1])
+                    if self.texture_file and self.texture_file != texture_file:
+                        raise Model.ModelParseError(f"{mtl_file} uses more than one texture (only one texture per model is supported).")
+                    self.texture_file = texture_file
+                    continue
                 line = line.strip().lower()
                 line_toks = line.split()
 
@@ -69,6 +152,14 @@ class Model:
             elif line_toks[0] == "usemtl": # Face material
                 current_mtl = "".join(line_toks[1:])
 
+            elif line_toks[0] == "vt": # Texture coordinates:
+                if len(line_toks) < 3:
+                    raise Model.ModelParseError(f"Problem in {filename} on line {line_num+1}: Texture coordinate has {len(line_toks) - 1} values, but must have at least 2.")
+                try:
+                    self.tex_coords.append((float(line_toks[1]), float(line_toks[2])))
+                except ValueError:
+                    raise Model.ModelParseError(f"Problem in {filename} on line {line_num+1}: Texture coordinate contains non-number value.")
+
             elif line.startswith("vn"): # Normals:
                 if (len(line_toks) != 4):
                     raise Model.ModelParseError(f"Problem in {filename} on line {line_num+1}: Vertex-normal has {len(line_toks) - 1} values, but must have exactly 3.")
@@ -80,6 +171,7 @@ class Model:
                             raise Model.ModelParseError(f"Problem in {filename} on line {line_num+1}: Vertex value {num} overflows the 24.8 signed fixed point format.")
                         norm.append(float2fx8(num))
                     self.normals.append(norm)
+                    self.normals_float.append([float(num) for num in line_toks[1:]])
                 except ValueError:
                     raise Model.ModelParseError(f"Problem in {filename} on line {line_num+1}: Vertex-normal contains non-number value.")
 
@@ -90,8 +182,8 @@ class Model:
                     vert = []
                     for num in line_toks[1:]:
                         num = float(num)
-                        if  abs(math.ceil(num)) > MAX_FX8:
-                            raise Model.ModelParseError(f"Problem in {filename} on line {line_num+1}: Vertex value {num} overflows the 24.8 signed fixed point format.")
+                        if not -32768 <= float2fx8(num) <= 32767: # The vertices are s16 in the ROM (cf. ModelVert in source/model.h).
+                            raise Model.ModelParseError(f"Problem in {filename} on line {line_num+1}: Vertex value {num} overflows the 8.8 signed fixed point format (scale the model down, and the instance up).")
                         vert.append(float2fx8(num))
                     self.verts.append(vert)
 
@@ -114,18 +206,26 @@ class Model:
                             raise Model.ModelParseError(f"Problem in {filename} on line {line_num+1}: Vertex index out of range.")
                         
                         face.vert_idx.append(vertIdx)
+                        if len(indices) >= 2 and indices[1]:
+                            face.tex_coord_idx.append(int(indices[1]) - 1)
                         if len(indices) == 3:
                             face.normal_idx = int(indices[2]) - 1 # Subtract 1, see above. 
+                            face.vert_normal_idx.append(face.normal_idx)
                             faceHasNormal = True
                     except ValueError as err:
                         raise Model.ModelParseError(f"Problem in {filename} on line {line_num+1}: '{line}' contains an invalid, non-integer vertex/normal index.")
 
-                if not faceHasNormal:
-                    raise Model.ModelParseError(f"Problem in {filename} on line {line_num+1}: Face has no normal.")
+                if not faceHasNormal or len(face.vert_normal_idx) != 3:
+                    raise Model.ModelParseError(f"Problem in {filename} on line {line_num+1}: Face has no normal (or not one for each vertex).")
 
                 self.faces.append(face)
         
 
+        if self.texture_file and not any(face.tex_coord_idx for face in self.faces):
+            self.texture_file = None # No texture coordinates, no texture. 
+        if self.texture_file and not all(len(face.tex_coord_idx) == 3 for face in self.faces):
+            raise Model.ModelParseError(f"{filename} has a texture, but not all of its faces have texture coordinates.")
+
         if self.max_model_verts != None and len(self.verts) > self.max_model_verts:
             raise Model.ModelParseError(f"Model has {len(self.verts)} vertices while MAX_MODEL_VERTS is {self.max_model_verts}.")
 
@@ -133,6 +233,464 @@ class Model:
             raise Model.ModelParseError(f"Model has {len(self.faces)} faces while MAX_MODEL_FACES is {self.max_model_faces}.")
 
 
+    def morph_keys_read(self, key_dir: pathlib.Path):
+        """ 
+        Reads the keys of the vertex animation from the .obj files in key_dir (in the order of their names); this model itself is the first key. 
+        All keys must have the same topology (the same number of vertices, and the same faces), only the positions of the vertices may differ. 
+        """
+        if self.bsp:
+            raise Model.ModelParseError(f"{self.input_filename}: Vertex animation (morph) can't be combined with bsp (the tree would only fit the first key).")
+        key_files = sorted(key_dir.glob("*.obj"))
+        if not key_files:
+            raise Model.ModelParseError(f"{self.input_filename}: No keys (.obj files) found in {key_dir} for the vertex animation.")
+        self.morph_keys = [self.verts]
+        for key_file in key_files:
+            key = Model(key_file, max_model_verts=self.max_model_verts, max_model_faces=self.max_model_faces)
+            if len(key.verts) != len(self.verts) or [face.vert_idx for face in key.faces] != [face.vert_idx for face in self.faces]:
+                raise Model.ModelParseError(f"{key_file} doesn't have the same vertices and faces as {self.input_filename} (a key may only move the vertices).")
+            self.morph_keys.append(key.verts)
+
+    def morph_code(self):
+        """ Returns the C code for the offsets of the vertices of all keys from the first key (cf. ModelMorph in source/model.h), as s8 if they fit (shifted, at most by 2), otherwise as s16. """
+        deltas = [vert[i] - base[i] for key in self.morph_keys for vert, base in zip(key, self.verts) for i in range(3)]
+        max_delta = max(max(deltas), -min(deltas))
+        shift = 0
+        while shift < 2 and ((max_delta + (1 << shift >> 1)) >> shift) > 127:
+            shift += 1
+        if ((max_delta + (1 << shift >> 1)) >> shift) <= 127:
+            deltas = [(d + (1 << shift >> 1)) >> shift for d in deltas] # (Rounded.)
+            deltas_string = f"const s8 {self.name}MorphDeltas[{len(deltas)}] = {{{', '.join(str(d) for d in deltas)}}};"
+            morph_string = f"const ModelMorph {self.name}Morph = {{.deltas8={self.name}MorphDeltas, .deltas16=NULL, .numKeys={len(self.morph_keys)}, .deltaShift={shift}}};"
+        else:
+            if max_delta > 32767:
+                raise Model.ModelParseError(f"{self.input_filename}: The vertices of the keys of the vertex animation are too far apart.")
+            deltas_string = f"const s16 {self.name}MorphDeltas[{len(deltas)}] = {{{', '.join(str(d) for d in deltas)}}};"
+            morph_string = f"const ModelMorph {self.name}Morph = {{.deltas8=NULL, .deltas16={self.name}MorphDeltas, .numKeys={len(self.morph_keys)}, .deltaShift=0}};"
+        return deltas_string + "\n\n" + morph_string
+
+    def prelit_shades(self):
+        """ 
+        Returns the shade (from 1 to 31) of each face lit by a directional light (self.prelit_light), like SHADING_FLAT_LIGHTING would light it in source/render/draw.c; 
+        draw.c looks it up in the shade ramp of the face's colour, so the face keeps its hue. 
+        """
+        length = math.sqrt(sum(c * c for c in self.prelit_light))
+        to_light = [-c / length for c in self.prelit_light]
+        shades = []
+        for face in self.faces:
+            n = self.normals_float[face.normal_idx]
+            n_length = math.sqrt(sum(c * c for c in n)) or 1
+            alpha = sum(to_light[k] * n[k] / n_length for k in range(3))
+            shade = min(max(1, int(alpha * 31)), 31) if alpha > 0 else 1
+            shades.append(shade)
+        return shades
+
+    def bounding_sphere(self):
+        """ Returns the center (centered on the axis-aligned bounding box) and the radius of a sphere enclosing all vertices (of all keys), in 24.8 fixed point. """
+        if len(self.verts) == 0:
+            return ([0, 0, 0], 0)
+        verts = [vert for key in self.morph_keys for vert in key] if self.morph_keys else self.verts
+        center = [(min(vert[i] for vert in verts) + max(vert[i] for vert in verts)) // 2 for i in range(3)]
+        radius = max(math.sqrt(sum((vert[i] - center[i])**2 for i in range(3))) for vert in verts)
+        return (center, math.ceil(radius) + 1) # Round up, we'd rather be a bit too conservative when culling.
+
+    def face_normals(self):
+        """ Returns the distinct (quantised) face normals, and the index into them for each face (flat shaded models have many faces in the same plane). """
+        normals, normal_idx, face_normal_idx = [], {}, []
+        for face in self.faces:
+            normal = tuple(self.normals[face.normal_idx])
+            if normal not in normal_idx:
+                normal_idx[normal] = len(normals)
+                normals.append(normal)
+            face_normal_idx.append(normal_idx[normal])
+        return normals, face_normal_idx
+
+    def unique_edges(self):
+        """ 
+        Returns the edges of the faces for SHADING_WIREFRAME, each only once, as [vertex index, vertex index, face index, second face index or None] (cf. ModelEdge in source/model.h). 
+        Vertices at the same position count as the same vertex. An edge of more than two faces only keeps the first two (for backface culling in draw.c). 
+        The edges are in the order of their first face, so the ones of the same colour come in a row.
+        """
+        edges, edge_idx = [], {}
+        for face_idx, face in enumerate(self.faces):
+            for i in range(3):
+                a, b = face.vert_idx[i], face.vert_idx[(i + 1) % 3]
+                key = tuple(sorted((tuple(self.verts[a]), tuple(self.verts[b]))))
+                if key[0] == key[1]: # Degenerate.
+                    continue
+                if key not in edge_idx:
+                    edge_idx[key] = len(edges)
+                    edges.append([a, b, face_idx, None])
+                elif edges[edge_idx[key]][3] is None and edges[edge_idx[key]][2] != face_idx:
+                    edges[edge_idx[key]][3] = face_idx
+        return edges
+
+    def decimated(self, num_faces, name):
+        """
+        Returns a copy of the model (called name) with at most num_faces faces (if we get there), for a lower level of detail. 
+        We collapse edges into one of their ends or their midpoint, cheapest first, where the cost of moving a vertex is the sum of its squared distances to the planes of 
+        its original faces (weighted by their area). Edges on the border of the mesh or between faces of different colours add planes perpendicular to their faces, 
+        so holes and colour borders keep their shape. Collapses which would flip a face, make the mesh non-manifold, or shrink its bounding box are skipped. 
+        The faces keep their colour, and get the normal of their new plane. Textured models are not supported. 
+        cf. https://www.cs.cmu.edu/~garland/Papers/quadrics.pdf (last retrieved 2021-08-22)
+        """
+        BORDER_WEIGHT = 16 # How much more the planes along borders weigh (relative to the squared length of their edges).
+        if self.texture_file:
+            raise Model.ModelParseError(f"{self.input_filename}: Levels of detail for textured models are not supported.")
+
+        verts = [[float(c) for c in vert] for vert in self.verts]
+        faces = [list(face.vert_idx) for face in self.faces]
+        colors = [face.color for face in self.faces]
+        alive = [True] * len(faces)
+        vert_faces = [set() for _ in verts]
+        for i, face in enumerate(faces):
+            for vert in face:
+                vert_faces[vert].add(i)
+
+        def cross(a, b):
+            return [a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]]
+
+        def face_normal(face, moved=None, pos=None):
+            """ The (unnormalised) normal of the face, with the vertex moved to pos. """
+            a, b, c = (pos if vert == moved else verts[vert] for vert in face)
+            return cross([b[k] - a[k] for k in range(3)], [c[k] - a[k] for k in range(3)])
+
+        def quadric(n, point, weight):
+            """ The quadric (the upper triangle of the symmetric 4x4 matrix) of the squared distance to the plane through point with the unit normal n. """
+            a, b, c = n
+            d = -sum(n[k] * point[k] for k in range(3))
+            return [weight * q for q in (a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d)]
+
+        def cost(q, v):
+            x, y, z = v
+            return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y + q[7] * z * z + 2 * q[8] * z + q[9]
+
+        quadrics = [[0.0] * 10 for _ in verts]
+        def add_quadric(vert, q):
+            quadrics[vert] = [quadrics[vert][k] + q[k] for k in range(10)]
+
+        edge_faces = {}
+        for i, face in enumerate(faces):
+            n = face_normal(face)
+            area = math.sqrt(sum(c * c for c in n))
+            if area == 0:
+                continue
+            n = [c / area for c in n]
+            for vert in face:
+                add_quadric(vert, quadric(n, verts[face[0]], area / 2))
+            for k in range(3):
+                edge_faces.setdefault((min(face[k], face[(k + 1) % 3]), max(face[k], face[(k + 1) % 3])), []).append(i)
+        for (a, b), adjacent in edge_faces.items():
+            if len(adjacent) == 2 and colors[adjacent[0]] == colors[adjacent[1]]:
+                continue
+            edge = [verts[b][k] - verts[a][k] for k in range(3)]
+            for i in adjacent:
+                n = cross(edge, face_normal(faces[i]))
+                length = math.sqrt(sum(c * c for c in n))
+                if length:
+                    q = quadric([c / length for c in n], verts[a], BORDER_WEIGHT * sum(c * c for c in edge))
+                    add_quadric(a, q)
+                    add_quadric(b, q)
+
+        lo = [min(vert[k] for vert in verts) for k in range(3)]
+        hi = [max(vert[k] for vert in verts) for k in range(3)]
+        tolerance = [(hi[k] - lo[k]) / 16 for k in range(3)]
+        def extent_kept(a, b, pos):
+            """ Whether the bounding box of the mesh stays the same (within tolerance) if we collapse a and b into pos; so small models don't lose their outline (and don't pop when the level changes). """
+            for k in range(3):
+                if min(verts[a][k], verts[b][k]) > lo[k] + tolerance[k] and max(verts[a][k], verts[b][k]) < hi[k] - tolerance[k]: # (Neither lies at the border.)
+                    continue
+                coords = [pos[k]] + [vert[k] for i, vert in enumerate(verts) if i != a and i != b and vert_faces[i]]
+                if min(coords) > lo[k] + tolerance[k] or max(coords) < hi[k] - tolerance[k]:
+                    return False
+            return True
+
+        def optimum(q, a, b):
+            """ The position with the smallest cost (where the gradient of the quadric is zero), if it is unique and not too far from the edge. """
+            m = [[q[0], q[1], q[2]], [q[1], q[4], q[5]], [q[2], q[5], q[7]]]
+            rhs = [-q[3], -q[6], -q[8]]
+            det = lambda m: m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0])
+            d = det(m)
+            if abs(d) < 1e-9 * max(1.0, max(abs(c) for c in q[:9])) ** 3:
+                return None
+            pos = [round(det([[rhs[i] if j == k else m[i][j] for j in range(3)] for i in range(3)]) / d) for k in range(3)] # (Cramer's rule.)
+            edge_len = math.sqrt(sum((verts[b][k] - verts[a][k]) ** 2 for k in range(3)))
+            if any(abs(c) > 32767 for c in pos) or math.sqrt(sum((pos[k] - verts[a][k]) ** 2 for k in range(3))) > 2 * edge_len:
+                return None
+            return pos
+
+        version = [0] * len(verts) # Bumped whenever a vertex moves, so we can skip outdated entries of the heap.
+        heap = []
+        def push_edge(a, b):
+            q = [quadrics[a][k] + quadrics[b][k] for k in range(10)]
+            candidates = [verts[a], verts[b], [round((verts[a][k] + verts[b][k]) / 2) for k in range(3)], optimum(q, a, b)]
+            pos = min((v for v in candidates if v and extent_kept(a, b, v)), key=lambda v: cost(q, v), default=None)
+            if pos:
+                heapq.heappush(heap, (cost(q, pos), a, b, version[a], version[b], pos))
+
+        def neighbours(vert):
+            return set(v for i in vert_faces[vert] for v in faces[i]) - {vert}
+
+        def collapse_ok(a, b, pos):
+            shared = [i for i in vert_faces[a] if b in faces[i]]
+            if len(neighbours(a) & neighbours(b)) != len(shared): # The link condition, cf. the paper.
+                return False
+            if not extent_kept(a, b, pos):
+                return False
+            for vert, other in ((a, b), (b, a)):
+                for i in vert_faces[vert]:
+                    if other in faces[i]:
+                        continue
+                    before, after = face_normal(faces[i]), face_normal(faces[i], vert, pos)
+                    len_before, len_after = math.sqrt(sum(c * c for c in before)), math.sqrt(sum(c * c for c in after))
+                    if len_after == 0 or sum(before[k] * after[k] for k in range(3)) < 0.3 * len_before * len_after:
+                        return False
+            return True
+
+        for a, b in edge_faces:
+            push_edge(a, b)
+        num_alive = len(faces)
+        while num_alive > num_faces and heap:
+            _, a, b, version_a, version_b, pos = heapq.heappop(heap)
+            if version_a != version[a] or version_b != version[b] or not vert_faces[a] or not vert_faces[b] or not collapse_ok(a, b, pos):
+                continue
+            verts[a] = pos
+            quadrics[a] = [quadrics[a][k] + quadrics[b][k] for k in range(10)]
+            for i in list(vert_faces[b]):
+                if a in faces[i]:
+                    alive[i] = False
+                    num_alive -= 1
+                    for vert in faces[i]:
+                        vert_faces[vert].discard(i)
+                else:
+                    faces[i] = [a if vert == b else vert for vert in faces[i]]
+                    vert_faces[a].add(i)
+            vert_faces[b] = set()
+            version[a] += 1
+            version[b] += 1
+            for vert in neighbours(a):
+                push_edge(a, vert)
+
+        lod = copy.copy(self)
+        lod.name = name
+        lod.lower_detail = None
+        used = sorted(set(vert for i, face in enumerate(faces) if alive[i] for vert in face))
+        remap = {vert: i for i, vert in enumerate(used)}
+        lod.verts = [[int(c) for c in verts[vert]] for vert in used]
+        lod.faces, lod.normals, lod.normals_float, lod.tex_coords = [], [], [], []
+        for i, face in enumerate(faces):
+            if not alive[i]:
+                continue
+            n = face_normal(face)
+            length = math.sqrt(sum(c * c for c in n)) or 1
+            lod_face = Model.Face()
+            lod_face.vert_idx = [remap[vert] for vert in face]
+            lod_face.normal_idx = len(lod.normals)
+            lod_face.vert_normal_idx = [lod_face.normal_idx] * 3
+            lod_face.color = colors[i]
+            lod.normals_float.append([c / length for c in n])
+            lod.normals.append([float2fx8(c / length) for c in n])
+            lod.faces.append(lod_face)
+        return lod
+
+    def bsp_build(self, vert_normals, face_vert_normals):
+        """
+        Builds a BSP tree of the faces, so draw.c can draw them back to front from any camera position without sorting (for static meshes whose faces overlap in ways the ordering table gets wrong). 
+        Every node stores a plane (a .8 fixed point unit normal and its distance from the origin) and the faces which lie in it; faces which straddle the plane of a node are split in two (or three). 
+        Replaces self.faces (reordered, so the faces of each node are contiguous) and appends the vertices, texture coordinates and vertex normals (vert_normals) of the split faces. 
+        Returns the nodes (with the root at index 0; node = [normal, dist, first_face, num_faces, front, back]) and the new face_vert_normals. 
+        cf. https://en.wikipedia.org/wiki/Binary_space_partitioning (last retrieved 2021-08-20)
+        """
+        EPSILON = 2 # Points closer to a plane than that (in .8 fixed point) lie in it, so the rounding of the vertices doesn't split faces needlessly.
+        SPLIT_COST = 12 # How much worse a split is than an unbalanced tree when we pick the planes.
+        MAX_CANDIDATES = 48 # Planes we try per node (from evenly spaced faces), so building larger models doesn't take forever. 
+
+        # A face during the build: [vertex indices, texture coordinate indices, vertex normal indices, the original face (for its colour and normal)]
+        polys = [[face.vert_idx, face.tex_coord_idx, face_vert_normals[i * 3:i * 3 + 3], face] for i, face in enumerate(self.faces)]
+
+        def plane_of(poly):
+            a, b, c = (self.verts[idx] for idx in poly[0])
+            u, v = [b[k] - a[k] for k in range(3)], [c[k] - a[k] for k in range(3)]
+            n = [u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0]]
+            length = math.sqrt(sum(c * c for c in n))
+            if length == 0: # Degenerate face.
+                return None
+            n = [c / length for c in n]
+            return (n, sum(n[k] * a[k] for k in range(3))) # (We classify with the exact normal; draw.c only needs the rounded one to tell on which side the camera is.)
+
+        def side_of(plane, vert_idx):
+            n, dist = plane
+            d = sum(n[k] * self.verts[vert_idx][k] for k in range(3)) - dist
+            return 0 if abs(d) <= EPSILON else (1 if d > 0 else -1)
+
+        def split_vert(plane, a, b, cache):
+            """ The (new) vertex where the edge from vertex a to b crosses the plane, and how far along the edge it lies. """
+            n, dist = plane
+            da = sum(n[k] * self.verts[a][k] for k in range(3)) - dist
+            db = sum(n[k] * self.verts[b][k] for k in range(3)) - dist
+            t = da / (da - db)
+            key = (min(a, b), max(a, b))
+            if key not in cache: # Faces which share the edge share the new vertex as well (no cracks).
+                cache[key] = len(self.verts)
+                self.verts.append([round(self.verts[a][k] + (self.verts[b][k] - self.verts[a][k]) * t) for k in range(3)])
+            return cache[key], t
+
+        def split(plane, poly, cache):
+            """ Splits the face into convex polygons in front and behind the plane, and triangulates them (as fans). """
+            front, back = [], []
+            corners = list(zip(*poly[:3])) if poly[1] else [(v, None, vn) for v, vn in zip(poly[0], poly[2])]
+            sides = [side_of(plane, corner[0]) for corner in corners]
+            for i in range(3):
+                corner, side = corners[i], sides[i]
+                next_corner, next_side = corners[(i + 1) % 3], sides[(i + 1) % 3]
+                if side >= 0:
+                    front.append(corner)
+                if side <= 0:
+                    back.append(corner)
+                if side * next_side < 0:
+                    vert, t = split_vert(plane, corner[0], next_corner[0], cache)
+                    tex_coord = None
+                    if corner[1] is not None:
+                        tex_coord = len(self.tex_coords)
+                        self.tex_coords.append([self.tex_coords[corner[1]][k] + (self.tex_coords[next_corner[1]][k] - self.tex_coords[corner[1]][k]) * t for k in range(2)])
+                    na, nb = vert_normals[corner[2]], vert_normals[next_corner[2]]
+                    normal = [na[k] + (nb[k] - na[k]) * t for k in range(3)]
+                    length = math.sqrt(sum(c * c for c in normal))
+                    vert_normals.append(tuple(round(c / length * 256) if length else na[k] for k, c in enumerate(normal)))
+                    new_corner = (vert, tex_coord, len(vert_normals) - 1)
+                    front.append(new_corner)
+                    back.append(new_corner)
+            fans = []
+            for polygon in (front, back):
+                part = []
+                for i in range(1, len(polygon) - 1):
+                    tri = (polygon[0], polygon[i], polygon[i + 1])
+                    part.append([[c[0] for c in tri], [c[1] for c in tri] if poly[1] else [], [c[2] for c in tri], poly[3]])
+                fans.append(part)
+            return fans
+
+        nodes, faces, out_vert_normals = [], [], []
+
+        def add_face(poly):
+            face = Model.Face()
+            face.vert_idx, face.tex_coord_idx, face.normal_idx, face.color = poly[0], poly[1], poly[3].normal_idx, poly[3].color
+            faces.append(face)
+            out_vert_normals.extend(poly[2])
+
+        def build(polys):
+            candidates = [plane for plane in (plane_of(poly) for poly in polys[::max(1, len(polys) // MAX_CANDIDATES)]) if plane]
+            best, best_cost = None, None
+            for plane in candidates:
+                num_front = num_back = num_split = 0
+                for poly in polys:
+                    sides = [side_of(plane, idx) for idx in poly[0]]
+                    if max(sides) > 0 and min(sides) < 0:
+                        num_split += 1
+                    elif max(sides) > 0:
+                        num_front += 1
+                    elif min(sides) < 0:
+                        num_back += 1
+                cost = num_split * SPLIT_COST + abs(num_front - num_back)
+                if best_cost is None or cost < best_cost:
+                    best, best_cost = plane, cost
+
+            node_idx = len(nodes)
+            if best is None: # Only degenerate faces left; they can't hide anything, so we put them all into one leaf (with any plane).
+                nodes.append([[0, 0, 1], 0, len(faces), len(polys), -1, -1])
+                for poly in polys:
+                    add_face(poly)
+                return node_idx
+            node = [best[0], best[1], len(faces), 0, -1, -1]
+            nodes.append(node)
+            front, back, cache = [], [], {}
+            for poly in polys:
+                sides = [side_of(best, idx) for idx in poly[0]]
+                if max(sides) > 0 and min(sides) < 0:
+                    front_part, back_part = split(best, poly, cache)
+                    front += front_part
+                    back += back_part
+                elif max(sides) > 0:
+                    front.append(poly)
+                elif min(sides) < 0:
+                    back.append(poly)
+                else: # In the plane.
+                    add_face(poly)
+            node[3] = len(faces) - node[2]
+            if front:
+                node[4] = build(front)
+            if back:
+                node[5] = build(back)
+            return node_idx
+
+        if polys:
+            build(polys)
+        self.faces = faces
+        if self.max_model_verts != None and len(self.verts) > self.max_model_verts:
+            raise Model.ModelParseError(f"Model has {len(self.verts)} vertices after building its BSP tree while MAX_MODEL_VERTS is {self.max_model_verts}.")
+        if self.max_model_faces != None and len(self.faces) > self.max_model_faces:
+            raise Model.ModelParseError(f"Model has {len(self.faces)} faces after building its BSP tree while MAX_MODEL_FACES is {self.max_model_faces}.")
+        return [[[round(c * 256) for c in node[0]], round(node[1])] + node[2:] for node in nodes], out_vert_normals
+
+    def vertex_normals(self, crease_angle=75):
+        """ 
+        Returns the vertex normals for Gouraud shading as a list of (.8 fixed point) unit normals, and the index into that list for each vertex of each face (three per face). 
+        The normal of a face's vertex is the average of the normals of the faces around that vertex, weighted by their angle at the vertex (so it doesn't matter how finely a surface is triangulated). 
+        Only faces whose normals are within crease_angle degrees of the face's own normal are averaged, so sharp edges (and thin, two-sided parts like suzanne's ears) stay sharp. 
+        """
+        face_normals = []
+        for face in self.faces: # The average of the .obj normals of the face's vertices (for flat shaded exports, all three are the face normal anyway).
+            n = [sum(self.normals_float[idx][k] for idx in face.vert_normal_idx) for k in range(3)]
+            length = math.sqrt(sum(c * c for c in n))
+            face_normals.append([c / length for c in n] if length else n)
+        vert_faces = [[] for _ in self.verts] # (face index, angle of the face at the vertex) for each vertex.
+        for face_idx, face in enumerate(self.faces):
+            for i in range(3):
+                p = self.verts[face.vert_idx[i]]
+                a = [self.verts[face.vert_idx[(i + 1) % 3]][k] - p[k] for k in range(3)]
+                b = [self.verts[face.vert_idx[(i + 2) % 3]][k] - p[k] for k in range(3)]
+                len_a, len_b = math.sqrt(sum(c * c for c in a)), math.sqrt(sum(c * c for c in b))
+                angle = math.acos(max(-1.0, min(1.0, sum(a[k] * b[k] for k in range(3)) / (len_a * len_b)))) if len_a and len_b else 0.0
+                vert_faces[face.vert_idx[i]].append((face_idx, angle))
+
+        min_cos = math.cos(math.radians(crease_angle))
+        vert_normals = []
+        normal_indices = {} # (vertex index, normal) -> index into vert_normals, so faces with the same normal at a vertex share it. 
+        face_vert_normals = []
+        for face_idx, face in enumerate(self.faces):
+            own = face_normals[face_idx]
+            for vert_idx in face.vert_idx:
+                n = [0.0, 0.0, 0.0]
+                for other_idx, angle in vert_faces[vert_idx]:
+                    other = face_normals[other_idx]
+                    if sum(own[k] * other[k] for k in range(3)) >= min_cos:
+                        n = [n[k] + other[k] * angle for k in range(3)]
+                length = math.sqrt(sum(c * c for c in n))
+                n = tuple(float2fx8(c / length) if length else float2fx8(own[k]) for k, c in enumerate(n))
+                if (vert_idx, n) not in normal_indices:
+                    normal_indices[(vert_idx, n)] = len(vert_normals)
+                    vert_normals.append(n)
+                face_vert_normals.append(normal_indices[(vert_idx, n)])
+        return vert_normals, face_vert_normals
+
+    def texture_code(self):
+        """ Returns the C code for the texture (RGB15 texels) and the texture coordinates (three per face, in texels), or None if the model is not textured. """
+        if not self.texture_file:
+            return None
+        if not self.texture_file.exists():
+            raise Model.ModelParseError(f"Texture '{self.texture_file}' of {self.input_filename} not found.")
+        width, height, pixels = png_read(self.texture_file)
+        if width & (width - 1) or height & (height - 1) or width > 256 or height > 256:
+            raise Model.ModelParseError(f"Texture '{self.texture_file}' is {width}x{height} pixels, but its dimensions must be powers of two (up to 256).")
+        texels = ", ".join(str((r >> 3) + ((g >> 3) << 5) + ((b >> 3) << 10)) for r, g, b in pixels)
+        texels_string = f"const COLOR {self.name}Texels[{width * height}] = {{{texels}}};"
+        texture_string = f"const Texture {self.name}Texture = {{.texels={self.name}Texels, .widthLog2={width.bit_length() - 1}, .heightLog2={height.bit_length() - 1}}};"
+        tex_coords_string = f"const TexCoord {self.name}TexCoords[{len(self.faces) * 3}] = {{"
+        for face in self.faces:
+            for idx in face.tex_coord_idx:
+                u, v = self.tex_coords[idx]
+                tex_coords_string += f"{{.u={float2fx8(u * width)},.v={float2fx8((1 - v) * height)}}}, " # In .obj files, v points upwards.
+        tex_coords_string += "};"
+        return texels_string + "\n\n" + texture_string + "\n\n" + tex_coords_string
+
     def generate_code(self) ->Dict:
         # Header file: 
         header_file = textwrap.dedent(f"""
@@ -145,31 +703,97 @@ class Model:
 
         #endif
         """)
+        if self.prelit_light: # So the scene can light everything else the same way.
+            header_file = header_file.replace("(void);\n", f"(void);\nextern const Vec3 {self.name}PrelitLight; // The direction of the light the shades were baked with (a unit vector in model space, cf. SHADING_PRELIT).\n")
         # Implementation/data file:
-        verts_string = f"const Vec3 {self.name}Verts[{len(self.verts)}] = {{"
+        vert_normals, face_vert_normals = self.vertex_normals()
+        bsp_nodes = None
+        if self.bsp: # (Adds vertices and faces, so we build it first.)
+            bsp_nodes, face_vert_normals = self.bsp_build(vert_normals, face_vert_normals)
+        verts_string = f"const ModelVert {self.name}Verts[{len(self.verts)}] = {{"
         faces_string = f"const Face {self.name}Faces[{len(self.faces)}] = {{"
+        face_normals, face_normal_idx = self.face_normals()
+        face_normals_string = f"const Vec3 {self.name}Normals[{len(face_normals)}] = {{"
+        vert_normals_string = f"const Vec3 {self.name}VertNormals[{len(vert_normals)}] = {{"
+        face_vert_normals_string = f"const u16 {self.name}FaceVertNormals[{len(face_vert_normals)}] = {{{', '.join(str(idx) for idx in face_vert_normals)}}};"
         model_string = f"Model {self.name}Model;" 
-        model_initfun= f"void {self.name}ModelInit(void) {{ {self.name}Model = modelNew({self.name}Verts, {self.name}Faces, {len(self.verts)}, {len(self.faces)}); }} "
+        bounds_center, bounds_radius = self.bounding_sphere()
+        bounds_string = f"(BoundingSphere){{.center={{.x={bounds_center[0]},.y={bounds_center[1]},.z={bounds_center[2]}}}, .radius={bounds_radius}}}"
+        texture_string = self.texture_code()
+        texture_init = f"{self.name}Model.texture = &{self.name}Texture; {self.name}Model.texCoords = {self.name}TexCoords; " if texture_string else ""
+        edges_string, edges_init = "", ""
+        if self.wireframe:
+            edges = self.unique_edges()
+            edges_string = f"const ModelEdge {self.name}Edges[{len(edges)}] = {{"
+            for a, b, face_a, face_b in edges:
+                edges_string += f"{{.vertexIndex={{{a}, {b}}}, .faceIndex={{{face_a}, {'MODEL_EDGE_NO_FACE' if face_b is None else face_b}}}}}, "
+            edges_string += "};"
+            edges_init = f"{self.name}Model.edges = {self.name}Edges; {self.name}Model.numEdges = {len(edges)}; "
+        bsp_string, bsp_init = "", ""
+        if bsp_nodes:
+            bsp_string = f"const BspNode {self.name}BspNodes[{len(bsp_nodes)}] = {{"
+            for normal, dist, first_face, num_faces, front, back in bsp_nodes:
+                bsp_string += f"{{.normalX={normal[0]},.normalY={normal[1]},.normalZ={normal[2]},.planeDist={dist},.firstFace={first_face},.numFaces={num_faces},.front={front},.back={back}}}, "
+            bsp_string += "};"
+            bsp_init = f"{self.name}Model.bspNodes = {self.name}BspNodes; {self.name}Model.numBspNodes = {len(bsp_nodes)}; "
+        prelit_string, prelit_init = "", ""
+        if self.prelit_light:
+            prelit_string = f"const u8 {self.name}PrelitShades[{len(self.faces)}] = {{{', '.join(str(c) for c in self.prelit_shades())}}};"
+            length = math.sqrt(sum(c * c for c in self.prelit_light))
+            light_x, light_y, light_z = (float2fx8(c / length) for c in self.prelit_light)
+            prelit_string += f"\nconst Vec3 {self.name}PrelitLight = {{.x={light_x}, .y={light_y}, .z={light_z}}};"
+            prelit_init = f"{self.name}Model.prelitShades = {self.name}PrelitShades; "
+        morph_string = self.morph_code() if self.morph_keys else ""
+        morph_init = f"{self.name}Model.morph = &{self.name}Morph; " if self.morph_keys else ""
+        lod_include, lod_init = "", ""
+        if self.lower_detail:
+            lod_include = f'#include "{self.lower_detail.name}Model.h"'
+            lod_init = f"{self.lower_detail.name}ModelInit(); {self.name}Model.lowerDetail = &{self.lower_detail.name}Model; "
+        model_initfun= f"void {self.name}ModelInit(void) {{ {self.name}Model = modelNew({self.name}Verts, {self.name}Faces, {self.name}Normals, {len(self.verts)}, {len(self.faces)}, {bounds_string}); {self.name}Model.vertNormals = {self.name}VertNormals; {self.name}Model.faceVertNormals = {self.name}FaceVertNormals; {self.name}Model.numVertNormals = {len(vert_normals)}; {texture_init}{edges_init}{bsp_init}{morph_init}{prelit_init}{lod_init}}} "
 
         for i, vert in enumerate(self.verts):
             verts_string += f"{{.x={vert[0]},.y={vert[1]},.z={vert[2]}}}, "
         verts_string += "};"
 
+        for normal in face_normals:
+            face_normals_string += f"{{.x={normal[0]},.y={normal[1]},.z={normal[2]}}}, "
+        face_normals_string += "};"
+
+        for normal in vert_normals:
+            vert_normals_string += f"{{.x={normal[0]},.y={normal[1]},.z={normal[2]}}}, "
+        vert_normals_string += "};"
+
         for i, face in enumerate(self.faces):
-            normal = self.normals[face.normal_idx]
             face_clr = f"{face.color[0] + (face.color[1]<<5) + (face.color[2]<<10)}"
-            faces_string += f"{{.vertexIndex = {{{face.vert_idx[0]}, {face.vert_idx[1]}, {face.vert_idx[2]}}}, .color = {face_clr}, .normal={{{normal[0]}, {normal[1]}, {normal[2]}}}, .type=TriangleFace}}, "
+            faces_string += f"{{.vertexIndex = {{{face.vert_idx[0]}, {face.vert_idx[1]}, {face.vert_idx[2]}}}, .normalIndex = {face_normal_idx[i]}, .color = {face_clr}}}, "
         faces_string += "};"
 
         data_file = textwrap.dedent(f"""
         #include "{self.name}Model.h"
+        {lod_include}
 
         {model_string}
 
         {verts_string}
 
+        {face_normals_string}
+
+        {vert_normals_string}
+
+        {face_vert_normals_string}
+
         {faces_string}
 
+        {texture_string or ""}
+
+        {edges_string}
+
+        {bsp_string}
+
+        {morph_string}
+
+        {prelit_string}
+
         {model_initfun}
         """)
         return {self.name + "Model.h": header_file, self.name + "Model.c": data_file}
@@ -199,6 +823,27 @@ def read_model_limits():
     return (MAX_MODEL_VERTS, MAX_MODEL_FACES)
 
 
+def read_model_config():
+    """ 
+    Reads the (optional) options of the models from assets/models/config, one "option: model names" per line; so far, there's only 
+    "bsp: subway" (build BSP trees for these models, cf. Model.bsp_build), "lod: tree" (generate lower levels of detail for these models, cf. Model.decimated), 
+    "wireframe: cpa" (export the unique edges of these models for SHADING_WIREFRAME, cf. Model.unique_edges), 
+    "morph: flag" (vertex animation with the keys in assets/models/flag/*.obj, cf. Model.morph_keys_read), 
+    and "prelit: flag" (bake the lit colours of the faces for SHADING_PRELIT, cf. Model.prelit_shades) with the direction of the light (in model space) given by "prelit-light: 3 -4 -3". 
+    """
+    config = {"bsp": [], "lod": [], "wireframe": [], "morph": [], "prelit": [], "prelit-light": []}
+    config_path = pathlib.Path(".").joinpath(MODEL_DIR).joinpath("config")
+    if config_path.exists():
+        for line_num, line in enumerate(open(config_path)):
+            if not line.strip() or line.strip().startswith("#"):
+                continue
+            option, _, names = line.partition(":")
+            if option.strip() not in config:
+                raise ValueError(f"{config_path} line {line_num + 1}: Unknown option '{option.strip()}'.")
+            config[option.strip()] += names.split()
+    return config
+
+
 # With respect to the project directory.
 SOURCE_DIR = "source/"
 MODEL_DIR = "assets/models/"
@@ -206,7 +851,28 @@ OUT_DIR_DATA = "data-models/"
 
 if __name__ == "__main__":
     MAX_MODEL_VERTS, MAX_MODEL_FACES = read_model_limits()
-    models = [Model(filepath, max_model_verts=MAX_MODEL_VERTS, max_model_faces=MAX_MODEL_FACES) for filepath in pathlib.Path(".").joinpath(MODEL_DIR).glob("*.obj")]
+    config = read_model_config()
+    models = [Model(filepath, max_model_verts=MAX_MODEL_VERTS, max_model_faces=MAX_MODEL_FACES, bsp=filepath.stem in config["bsp"], wireframe=filepath.stem in config["wireframe"]) for filepath in pathlib.Path(".").joinpath(MODEL_DIR).glob("*.obj")]
+    prelit_light = [float(c) for c in config["prelit-light"]] or [3, -4, -3]
+    if len(prelit_light) != 3 or not any(prelit_light):
+        raise ValueError(f"prelit-light in the config must be a direction (three numbers, not all zero), but is {config['prelit-light']}.")
+    for model in models: # (Before the levels of detail are generated, which are copies of the model.)
+        if model.name in config["prelit"]:
+            model.prelit_light = prelit_light
+        if model.name in config["morph"]:
+            if model.name in config["lod"]:
+                raise Model.ModelParseError(f"{model.input_filename}: Vertex animation (morph) can't be combined with lod (yet).")
+            model.morph_keys_read(pathlib.Path(".").joinpath(MODEL_DIR).joinpath(model.name))
+    for model in list(models): # Two lower levels of detail (with half and a quarter of the faces), each written like a model of its own (e.g. treeLod1Model), and initialised by the model's init function. 
+        if model.name in config["lod"]:
+            finer = model
+            for level in (1, 2):
+                lod = model.decimated(len(model.faces) >> level, f"{model.name}Lod{level}")
+                if len(lod.faces) < 4 or len(lod.faces) > len(finer.faces) * 3 // 4: # Not worth it.
+                    break
+                finer.lower_detail = lod
+                models.append(lod)
+                finer = lod
 
     modelsWritten = 0
     infile_paths = [str(model.input_filename.relative_to(pathlib.Path("."))) for model in models]